@@ -0,0 +1,381 @@
+/* ee-logs-bloom.h */
+/*
+ Bloom filters of codes of events of blocks of records for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Code of record is little endian unsigned number of WIDTH bytes
+	(1 or 2) from byte OFFSET of record (flag bit is cleared as
+	Log_Read* functions do).
+
+	Slots of ring are divided into blocks of BLOCK slots (as in
+	ee-logs-zone.h).  For every block a Bloom filter of codes of its
+	records (LOG_BLOOM_BYTES bytes, LOG_BLOOM_K bits for a code) is
+	kept in RAM, so a query reads only records of blocks which
+	filter has the code (and false positive blocks).
+
+	Filters are built by Log_BloomBuild (reads all records) or
+	loaded from EEPROM by Log_BloomLoad, and are updated by
+	Log_BloomNote for every written record (it must be called from
+	LOG_WRITE_HOOK of ee-logs.h).  A written record is added to
+	filter of its block; when all slots of block are rewritten, the
+	filter is replaced by filter of new records only.
+
+	Log_BloomSave writes filters to EEPROM (LOG_BLOOM_SIZE bytes at
+	address ADDR, out of ring of log): filters, number and flag of
+	the 'free' record of ring at start of saving and check sum.
+	Log_BloomLoad reads them and adds records written after saving
+	(so filters are valid even if saving is interrupted by appending
+	of records); if check sum is wrong (first start, power loss
+	while saving) or RECS and more records are written after saving,
+	the filters are built.  2*RECS and more written records are not
+	detected, so save filters at least once per 2*RECS records.
+
+	False positive rate for N different codes in block of BLOCK
+	records is about (1 - exp(-K*N/M))^K, where M is
+	8*LOG_BLOOM_BYTES; ee-logs-bench (built with -DBENCH_BLOOM)
+	measures it.
+
+
+ Configuration macros (define it before include this file):
+
+ LOG_BLOOM_BYTES
+	size of filter of block (power of 2, 1..32, default 8)
+
+ LOG_BLOOM_K
+	number of bits set for a code (1..8, default 2)
+
+
+ Define these macros and functions:
+
+ DECLARE_LOG_BLOOM( NAME )
+	declare Bloom filters of log NAME
+
+ LOG_BLOOM( NAME, RECS, REC_SIZE, OFFSET, WIDTH, BLOCK )
+	define Bloom filters of log NAME (log must be defined by
+	LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it in the
+	same file), 1 <= BLOCK <= RECS
+
+ LOG_BLOOM_SIZE( RECS, BLOCK )
+	bytes of EEPROM used by Log_BloomSave
+
+ Log_BloomBuild( NAME )
+	build filters of log NAME (call it after Log_Init)
+
+ Log_BloomLoad( NAME, ADDR )
+	load filters of log NAME saved at address ADDR (call it after
+	Log_Init instead of Log_BloomBuild)
+
+ Log_BloomSave( NAME, ADDR )
+	no blocking write filters of log NAME to address ADDR; call
+	this function periodical until it returns not 0 (as
+	Log_NoblockingWrite( NAME, 0 ) for writing of records);
+	return not 0 if all bytes are written
+
+ Log_BloomNote( NAME, unsigned char SLOT, void * REC )
+	record REC is written to slot SLOT of ring (the arguments of
+	LOG_WRITE_HOOK)
+
+ Log_BloomMay( NAME, CODE )
+	return 0 if there is no record with code CODE in log (reads
+	nothing from EEPROM), else return not 0 (there may be)
+
+ Log_BloomLast( NAME, CODE, void * DST )
+	read the last (the newest) record of log NAME with code CODE
+	to address DST;
+	return 0 if there is no such record, else return not 0
+	and the read record become the 'current record'
+
+ Log_BloomPrev( NAME, CODE, void * DST )
+	read the previous record before the 'current record' with code
+	CODE (as Log_BloomLast)
+
+
+ Example (RAM: 13 blocks * 8 bytes; EEPROM: 100 records from 0 and
+ LOG_BLOOM_SIZE( 100, 8 ) = 107 bytes of filters from 800):
+
+	#define LOG_WRITE_HOOK( name, slot, rec )			\
+		Log_BloomNote ## name ( slot, rec )
+	#include "ee-logs.h"
+	#include "ee-logs-bloom.h"
+
+	DECLARE_LOGGER( Ev, 100, 8, 0 )
+	DECLARE_LOG_BLOOM( Ev )
+	LOGGER( Ev, 100, 8, 0 )
+	LOG_BLOOM( Ev, 100, 8, 0, 1, 8 )	-- code of event in byte 0
+
+	Log_Init( Ev ); Log_BloomLoad( Ev, 800 );
+	...
+	if ( Log_BloomLast( Ev, EV_RESET, rec ) ) ...
+	...
+	while ( !Log_BloomSave( Ev, 800 ) ) ;	-- before power off
+
+*/
+
+
+#ifndef EE_LOGS_BLOOM_H
+#define EE_LOGS_BLOOM_H
+
+#ifndef LOG_BLOOM_BYTES
+#define LOG_BLOOM_BYTES	8
+#endif
+#ifndef LOG_BLOOM_K
+#define LOG_BLOOM_K	2
+#endif
+
+#define LOG_BLOOM_SIZE( recs, block )					\
+	( ((recs) + (block) - 1) / (block) * LOG_BLOOM_BYTES + 3 )
+
+/* code of record rec of size n */
+static inline unsigned int
+Log_BloomCode( const unsigned char * rec, unsigned char n,
+		unsigned char off, unsigned char width )
+{
+	unsigned int c = rec[off];
+	if ( width == 2 ) c |= (unsigned int) rec[off + 1] << 8;
+	if ( off + width == n )
+		c &= ~( (unsigned int) LOG_FLAG_MASK << (8 * (width - 1)) );
+	return c;
+}
+
+/* bits of code c (double hashing) are set in f (set) or tested */
+static inline unsigned char
+Log_BloomBits( unsigned char * f, unsigned int c, unsigned char set )
+{
+	unsigned char h1, h2, i, b;
+	c = ( c * 0x2F1Bu + 0x55u ) & 0xFFFF;
+	h1 = (unsigned char) c;
+	h2 = (unsigned char)( c >> 8 ) | 1;
+	for ( i = 0; i < LOG_BLOOM_K; ++i, h1 += h2 )
+	{
+		b = h1 & (8 * LOG_BLOOM_BYTES - 1);
+		if ( set ) f[b >> 3] |= (unsigned char)( 1u << (b & 7) );
+		else if ( !(f[b >> 3] & (1u << (b & 7))) ) return 0;
+	}
+	return 1;
+}
+
+#endif /* EE_LOGS_BLOOM_H */
+
+
+#define DECLARE_LOG_BLOOM( name )					\
+									\
+void Log_BloomBuild ## name ( void );					\
+void Log_BloomLoad ## name ( unsigned int addr );			\
+unsigned char Log_BloomSave ## name ( unsigned int addr );		\
+void Log_BloomNote ## name ( unsigned char slot, const unsigned char * rec );\
+unsigned char Log_BloomMay ## name ( unsigned int code );		\
+unsigned char Log_BloomLast ## name ( unsigned int code, unsigned char * dst );\
+unsigned char Log_BloomPrev ## name ( unsigned int code, unsigned char * dst );
+
+
+#define Log_BloomBuild( name )		Log_BloomBuild ## name ()
+#define Log_BloomLoad( name, addr )	Log_BloomLoad ## name ( addr )
+#define Log_BloomSave( name, addr )	Log_BloomSave ## name ( addr )
+#define Log_BloomNote( name, slot, rec )	Log_BloomNote ## name ( slot, rec )
+#define Log_BloomMay( name, code )	Log_BloomMay ## name ( code )
+#define Log_BloomLast( name, code, dst )	Log_BloomLast ## name ( code, dst )
+#define Log_BloomPrev( name, code, dst )	Log_BloomPrev ## name ( code, dst )
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_BLOOM( name, recs, rec_size, off, width, block )		\
+									\
+typedef char Log_BloomFits__ ## name					\
+	[ ((width) >= 1 && (width) <= 2 && (off) + (width) <= (rec_size)\
+	  && (block) >= 1 && (block) <= (recs)				\
+	  && Log_IsPow2( LOG_BLOOM_BYTES ) && LOG_BLOOM_BYTES <= 32) ? 1 : -1 ];\
+									\
+static unsigned char							\
+	Log_Bloom__ ## name [((recs) + (block) - 1) / (block)][LOG_BLOOM_BYTES];\
+static unsigned char Log_BloomNew__ ## name [LOG_BLOOM_BYTES];		\
+static unsigned char Log_BloomFill__ ## name;	/* rewritten slots */	\
+static unsigned int Log_BloomPos__ ## name;	/* saved bytes */	\
+static unsigned char Log_BloomSum__ ## name;				\
+static unsigned char Log_BloomFree__ ## name;	/* at start of saving */\
+static unsigned char Log_BloomFlag__ ## name;				\
+									\
+void									\
+Log_BloomNote ## name ( unsigned char slot, const unsigned char * rec )	\
+{									\
+	unsigned int c = Log_BloomCode( rec, (rec_size), (off), (width) );\
+	unsigned char * f = Log_Bloom__ ## name [slot / (block)];	\
+	unsigned char i;						\
+	Log_BloomBits( f, c, 1 );					\
+	if ( slot % (block) == 0 )					\
+	{ /* block is being rewritten */				\
+		for ( i = 0; i < LOG_BLOOM_BYTES; ++i )			\
+			Log_BloomNew__ ## name [i] = 0;			\
+		Log_BloomFill__ ## name = 0;				\
+	}								\
+	else if ( Log_BloomFill__ ## name != slot % (block) )		\
+	{ /* not from start of block */					\
+		Log_BloomFill__ ## name = 0xFF;				\
+		return;							\
+	}								\
+	Log_BloomBits( Log_BloomNew__ ## name, c, 1 );			\
+	if ( ++ Log_BloomFill__ ## name == (block) || slot == (recs)-1 )\
+	{ /* all slots of block are rewritten */			\
+		for ( i = 0; i < LOG_BLOOM_BYTES; ++i )			\
+			f[i] = Log_BloomNew__ ## name [i];		\
+		Log_BloomFill__ ## name = 0xFF;				\
+	}								\
+}									\
+									\
+/* add records from slot r to the 'free' record */			\
+static void								\
+Log_BloomAdd__ ## name ( unsigned char r )				\
+{									\
+	unsigned char rec[rec_size];					\
+	while ( r != Log_State__ ## name .rec )				\
+	{								\
+		Log_ReadRec__ ## name ( rec, r );			\
+		Log_BloomBits( Log_Bloom__ ## name [r / (block)],	\
+			Log_BloomCode( rec, (rec_size), (off), (width) ), 1 );\
+		Log_IncRec( r, recs );					\
+	}								\
+}									\
+									\
+void									\
+Log_BloomBuild ## name ( void )						\
+{									\
+	unsigned char * f = Log_Bloom__ ## name [0];			\
+	unsigned int i = sizeof( Log_Bloom__ ## name );			\
+	do *f++ = 0; while ( --i );					\
+	Log_BloomFill__ ## name = 0xFF;					\
+	i = Log_State__ ## name .rec;					\
+	Log_IncRec( i, recs );						\
+	Log_BloomAdd__ ## name ( (unsigned char) i );			\
+}									\
+									\
+void									\
+Log_BloomLoad ## name ( unsigned int addr )				\
+{									\
+	unsigned char * f = Log_Bloom__ ## name [0];			\
+	unsigned int i = sizeof( Log_Bloom__ ## name );			\
+	unsigned char s = 0, r, g;					\
+	Log_BusWait();							\
+	do {								\
+		s += *f++ = ReadEE( (void*) addr );			\
+		++addr;							\
+		Log_BusYield( i );					\
+	} while ( --i );						\
+	r = ReadEE( (void*) addr );					\
+	g = ReadEE( (void*)( addr + 1 ) );				\
+	s = (unsigned char)( s + r + g - ReadEE( (void*)( addr + 2 ) ) );\
+	Log_BusRelease();						\
+	/* the same pass of ring: r <= 'free'; the next pass: r > 'free' */\
+	g = ( g == Log_CurFlag( name ) );				\
+	if ( s || r >= (recs) || g != (r <= Log_State__ ## name .rec) )	\
+	{ Log_BloomBuild ## name (); return; }				\
+	Log_BloomFill__ ## name = 0xFF;					\
+	Log_BloomAdd__ ## name ( r );					\
+}									\
+									\
+unsigned char								\
+Log_BloomSave ## name ( unsigned int addr )				\
+{									\
+	unsigned int i = Log_BloomPos__ ## name;			\
+	unsigned char b;						\
+	if ( !isEEfree() ) return 0;					\
+	if ( i == sizeof( Log_Bloom__ ## name ) + 3 )			\
+	{ /* the last byte is written */				\
+		Log_BloomPos__ ## name = 0;				\
+		return 1;						\
+	}								\
+	if ( !Log_BusAcquire() ) return 0;				\
+	if ( !i )							\
+	{								\
+		Log_BloomFree__ ## name = Log_State__ ## name .rec;	\
+		Log_BloomFlag__ ## name = Log_CurFlag( name );		\
+		Log_BloomSum__ ## name = 0;				\
+	}								\
+	if ( i < sizeof( Log_Bloom__ ## name ) )			\
+		b = Log_Bloom__ ## name [0][i];				\
+	else if ( i == sizeof( Log_Bloom__ ## name ) )			\
+		b = Log_BloomFree__ ## name;				\
+	else if ( i == sizeof( Log_Bloom__ ## name ) + 1 )		\
+		b = Log_BloomFlag__ ## name;				\
+	else								\
+		b = Log_BloomSum__ ## name;				\
+	Log_BloomSum__ ## name += b;					\
+	WriteEE( (void*)( addr + i ), b );				\
+	Log_BloomPos__ ## name = i + 1;					\
+	Log_BusRelease();						\
+	return 0;							\
+}									\
+									\
+unsigned char								\
+Log_BloomMay ## name ( unsigned int code )				\
+{									\
+	unsigned char k = 0;						\
+	do {								\
+		if ( Log_BloomBits( Log_Bloom__ ## name [k], code, 0 ) )\
+			return 1;					\
+	} while ( ++k < ((recs) + (block) - 1) / (block) );		\
+	return 0;							\
+}									\
+									\
+/* read the newest record with code from slot r back */			\
+static unsigned char							\
+Log_BloomSeek__ ## name ( unsigned int code, unsigned char * dst,	\
+			unsigned char r )				\
+{									\
+	unsigned char b;						\
+	while ( r != Log_State__ ## name .rec )				\
+	{								\
+		b = r / (block);					\
+		if ( !Log_BloomBits( Log_Bloom__ ## name [b], code, 0 ) )\
+		{ /* skip block (up to the 'free' record) */		\
+			if ( r > Log_State__ ## name .rec		\
+				&& Log_State__ ## name .rec >= b * (block) )\
+				return 0;				\
+			r = b ? b * (block) - 1 : (recs) - 1;		\
+			continue;					\
+		}							\
+		Log_ReadRec__ ## name ( dst, r );			\
+		if ( Log_BloomCode( dst, (rec_size), (off), (width) ) == code )\
+		{							\
+			Log_State__ ## name .read = r;			\
+			return 1;					\
+		}							\
+		Log_DecRec( r, recs );					\
+	}								\
+	return 0;							\
+}									\
+									\
+unsigned char								\
+Log_BloomLast ## name ( unsigned int code, unsigned char * dst )	\
+{									\
+	unsigned char r = Log_State__ ## name .rec;			\
+	Log_DecRec( r, recs );						\
+	return Log_BloomSeek__ ## name ( code, dst, r );		\
+}									\
+									\
+unsigned char								\
+Log_BloomPrev ## name ( unsigned int code, unsigned char * dst )	\
+{									\
+	unsigned char r = Log_State__ ## name .read;			\
+	Log_DecRec( r, recs );						\
+	return Log_BloomSeek__ ## name ( code, dst, r );		\
+}
+
+
+/* End of file  ee-logs-bloom.h */
@@ -0,0 +1,138 @@
+/* ee-logs-count.h */
+/*
+ Counters of records of every code of event for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Code of record is byte OFFSET of record (flag bit is cleared as
+	Log_Read* functions do).  For every code 0..NCODES-1 number of
+	records of log with this code is kept in RAM (one byte for a
+	code: log has less than 255 records), so count of events is
+	got without reading of log.  Records with code NCODES and more
+	are not counted.
+
+	Counters are built by Log_CountBuild (reads all records) and are
+	updated by Log_CountNote for every written record (it must be
+	called from LOG_WRITE_HOOK of ee-logs.h): counter of code of the
+	written record is incremented and counter of code of the oldest
+	record (it is read from EEPROM before it is overwritten) is
+	decremented.
+
+
+ Define these macros and functions:
+
+ DECLARE_LOG_COUNT( NAME )
+	declare counters of log NAME
+
+ LOG_COUNT( NAME, RECS, REC_SIZE, START_ADDR, OFFSET, NCODES )
+	define counters of log NAME (log must be defined by
+	LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it in the
+	same file), 1 <= NCODES <= 256
+
+ Log_CountBuild( NAME )
+	count records of log NAME (call it after Log_Init)
+
+ Log_CountNote( NAME, unsigned char SLOT, void * REC )
+	record REC is written to slot SLOT of ring (the arguments of
+	LOG_WRITE_HOOK)
+
+ Log_Count( NAME, CODE )
+	return number of records of log NAME with code CODE
+	(0 <= CODE < NCODES)
+
+
+ Example (queue or Log_NoblockingWrite writes records):
+
+	#define LOG_WRITE_HOOK( name, slot, rec )			\
+		Log_CountNote ## name ( slot, rec )
+	#include "ee-logs.h"
+	#include "ee-logs-count.h"
+
+	DECLARE_LOGGER( Ev, 100, 8, 0 )
+	DECLARE_LOG_COUNT( Ev )
+	LOGGER( Ev, 100, 8, 0 )
+	LOG_COUNT( Ev, 100, 8, 0, 0, 32 )	-- code of event in byte 0
+
+	Log_Init( Ev ); Log_CountBuild( Ev );
+	...
+	n = Log_Count( Ev, EV_RESET );
+
+*/
+
+
+#define DECLARE_LOG_COUNT( name )					\
+									\
+void Log_CountBuild ## name ( void );					\
+void Log_CountNote ## name ( unsigned char slot, const unsigned char * rec );\
+									\
+static inline unsigned char						\
+Log_Count ## name ( unsigned char code )				\
+{									\
+	extern unsigned char Log_Count__ ## name [];			\
+	return Log_Count__ ## name [code];				\
+}
+
+
+#define Log_CountBuild( name )		Log_CountBuild ## name ()
+#define Log_CountNote( name, slot, rec )	Log_CountNote ## name ( slot, rec )
+#define Log_Count( name, code )		Log_Count ## name ( code )
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_COUNT( name, recs, rec_size, start_addr, off, ncodes )	\
+									\
+typedef char Log_CountFits__ ## name					\
+	[ ((off) < (rec_size) && (ncodes) >= 1 && (ncodes) <= 256) ? 1 : -1 ];\
+									\
+unsigned char Log_Count__ ## name [ncodes];				\
+									\
+void									\
+Log_CountBuild ## name ( void )						\
+{									\
+	unsigned char rec[rec_size];					\
+	unsigned char r = Log_State__ ## name .rec;			\
+	unsigned int i = 0;						\
+	do Log_Count__ ## name [i] = 0; while ( ++i < (ncodes) );	\
+	Log_IncRec( r, recs );						\
+	while ( r != Log_State__ ## name .rec )				\
+	{								\
+		Log_ReadRec__ ## name ( rec, r );			\
+		i = rec[off];						\
+		if ( i < (ncodes) ) ++ Log_Count__ ## name [i];		\
+		Log_IncRec( r, recs );					\
+	}								\
+}									\
+									\
+void									\
+Log_CountNote ## name ( unsigned char slot, const unsigned char * rec )	\
+{									\
+	unsigned int c = rec[off];	/* (NCODES may be 256) */	\
+	if ( (off) == (rec_size)-1 ) c &= (unsigned char)~LOG_FLAG_MASK;\
+	if ( c < (ncodes) ) ++ Log_Count__ ## name [c];			\
+	/* the oldest record is removed */				\
+	Log_IncRec( slot, recs );					\
+	c = ReadEE( (void*)( Log_RecAddr( start_addr, rec_size, slot )	\
+				+ (off) ) );				\
+	if ( (off) == (rec_size)-1 ) c &= (unsigned char)~LOG_FLAG_MASK;\
+	if ( c < (ncodes) ) -- Log_Count__ ## name [c];			\
+}
+
+
+/* End of file  ee-logs-count.h */
@@ -0,0 +1,410 @@
+/* ee-logs-delta.h */
+/*
+ Delta encoding of samples for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	A sample is NV values of 16 bits (unsigned int, only low 16
+	bits are kept).  Samples are written to records of log as
+	differences from the previous sample (one signed byte for every
+	value), so a record has many samples.
+
+	Record of log (REC_SIZE bytes):
+		byte 0 -- number of samples in record (N);
+		checkpoint record: the first sample (2 bytes for every
+		value, little endian), then N-1 samples of differences;
+		other record: N samples of differences;
+		the last byte -- LOG_DELTA_KEY for checkpoint record, else
+		number of record after the checkpoint (1..EVERY-1).
+
+	Every EVERY-th record is a checkpoint (self-contained record),
+	also a checkpoint is started if difference does not fit into
+	signed byte.  So a sample is decoded from its record and at most
+	EVERY-1 records before it: when the ring wraps and the oldest
+	checkpoint is overwritten, only records of its chain are lost
+	(they are skipped by readers) and reading from any place of log
+	costs less than 2*EVERY reads of records (a reader which finds
+	a broken chain does not try other records of the chain: it goes
+	to the next checkpoint or to the record before the chain).
+
+	Readers keep the record with the 'current sample' in RAM, so
+	moving to the next (previous) sample inside the record reads
+	nothing from EEPROM.
+
+
+ Define these macros and functions:
+
+ DECLARE_LOG_DELTA( NAME )
+	declare delta encoding of log NAME
+
+ LOG_DELTA( NAME, REC_SIZE, NV, EVERY )
+	define delta encoding of log NAME (log must be defined by
+	LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it in the
+	same file) for samples of NV values;
+	must have:
+		2 * NV <= REC_SIZE - 2
+		1 <= EVERY <= 64, EVERY < RECS
+
+ Log_DeltaPut( NAME, unsigned int * V )
+	put sample (NV values from address V) to record;
+	return not 0 if the sample is put;
+	return 0 if the record is being written now (also when the
+	sample needs a checkpoint: then the record is closed)
+
+ Log_DeltaCommit( NAME )
+	start writing of record even if it is not full
+
+ Log_DeltaFlush( NAME )
+	write record to log; call this function periodical;
+	return not 0 if nothing is being written (as
+	Log_NoblockingWrite( NAME, 0 ))
+
+ Log_DeltaReadFirst( NAME, unsigned int * DST )
+ Log_DeltaReadLast( NAME, unsigned int * DST )
+ Log_DeltaReadNext( NAME, unsigned int * DST )
+ Log_DeltaReadPrev( NAME, unsigned int * DST )
+	read the first (last, next, previous) sample of log NAME to
+	address DST (buffer must have NV values);
+	return 0 if there is no such sample, else return not 0;
+	the read sample become the 'current sample'
+
+*/
+
+
+#ifndef EE_LOGS_DELTA_H
+#define EE_LOGS_DELTA_H
+
+#define LOG_DELTA_KEY	((unsigned char)0x40)	/* checkpoint record */
+#define LOG_DELTA_SEQ	((unsigned char)0x3F)
+
+/* samples in checkpoint record and in other record */
+#define Log_DeltaKeyCap( rec_size, nv )					\
+	( 1 + ((rec_size) - 2 - 2 * (nv)) / (nv) )
+#define Log_DeltaCap( rec_size, nv )	( ((rec_size) - 2) / (nv) )
+
+
+/* add differences from p to values v */
+static inline void
+Log_DeltaStep( unsigned int * v, const unsigned char * p, unsigned char nv )
+{
+	do {
+		*v = (*v + (unsigned int)(signed char)*p++) & 0xFFFF;
+		++v;
+	} while ( --nv );
+}
+
+/*
+	decode sample k of record rec (key -- it is a checkpoint) to v;
+	v has the last sample of previous record (not used for checkpoint)
+*/
+static void
+Log_DeltaDecode( unsigned int * v, const unsigned char * rec,
+		unsigned char nv, unsigned char key, unsigned char k )
+{
+	const unsigned char * p = rec + 1;
+	unsigned char i;
+	if ( key )
+	{
+		for ( i = 0; i < nv; ++i, p += 2 )
+			v[i] = p[0] | (unsigned int) p[1] << 8;
+		if ( !k ) return;
+		--k;
+	}
+	do {
+		Log_DeltaStep( v, p, nv );
+		p += nv;
+	} while ( k-- );
+}
+
+#endif /* EE_LOGS_DELTA_H */
+
+
+#define DECLARE_LOG_DELTA( name )					\
+									\
+unsigned char Log_DeltaPut ## name ( const unsigned int * v );		\
+void Log_DeltaCommit ## name ( void );					\
+unsigned char Log_DeltaFlush ## name ( void );				\
+unsigned char Log_DeltaReadFirst ## name ( unsigned int * dst );	\
+unsigned char Log_DeltaReadLast ## name ( unsigned int * dst );		\
+unsigned char Log_DeltaReadNext ## name ( unsigned int * dst );		\
+unsigned char Log_DeltaReadPrev ## name ( unsigned int * dst );
+
+
+#define Log_DeltaPut( name, v )		Log_DeltaPut ## name ( v )
+#define Log_DeltaCommit( name )		Log_DeltaCommit ## name ()
+#define Log_DeltaFlush( name )		Log_DeltaFlush ## name ()
+#define Log_DeltaReadFirst( name, dst )	Log_DeltaReadFirst ## name ( dst )
+#define Log_DeltaReadLast( name, dst )	Log_DeltaReadLast ## name ( dst )
+#define Log_DeltaReadNext( name, dst )	Log_DeltaReadNext ## name ( dst )
+#define Log_DeltaReadPrev( name, dst )	Log_DeltaReadPrev ## name ( dst )
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_DELTA( name, rec_size, nv, every )				\
+									\
+typedef char Log_DeltaFits__ ## name					\
+	[ (2 * (nv) <= (rec_size) - 2 && (every) >= 1 && (every) <= 64	\
+		&& (every) < Log_Recs__ ## name) ? 1 : -1 ];		\
+									\
+/* writer */								\
+static unsigned char Log_DltRec__ ## name [rec_size];			\
+static unsigned int Log_DltPrev__ ## name [nv];	/* the last sample */	\
+static unsigned char Log_DltN__ ## name;	/* samples in record */	\
+static unsigned char Log_DltSeq__ ## name;	/* 0 -- checkpoint */	\
+static unsigned char Log_DltKey__ ## name;	/* next is checkpoint */\
+static unsigned char Log_DltBusy__ ## name;	/* record is written */	\
+									\
+/* reader: record of the 'current sample' */				\
+static unsigned char Log_DltRRec__ ## name [rec_size];			\
+static unsigned int Log_DltBase__ ## name [nv];	/* before record */	\
+static unsigned int Log_DltVal__ ## name [nv];	/* 'current sample' */	\
+static unsigned char Log_DltIdx__ ## name;	/* sample in record */	\
+static unsigned char Log_DltCur__ ## name;	/* record in log */	\
+									\
+unsigned char								\
+Log_DeltaPut ## name ( const unsigned int * v )				\
+{									\
+	unsigned char * p;						\
+	unsigned char i;						\
+	unsigned int d;							\
+	if ( Log_DltBusy__ ## name ) return 0;				\
+	p = Log_DltRec__ ## name + 1;					\
+	if ( !Log_DltN__ ## name && Log_DltKey__ ## name )		\
+	{ /* the next record is checkpoint */				\
+		Log_DltSeq__ ## name = 0;				\
+		Log_DltKey__ ## name = 0;				\
+	}								\
+	if ( !Log_DltN__ ## name && !Log_DltSeq__ ## name )		\
+	{ /* the first sample of checkpoint */				\
+		for ( i = 0; i < (nv); ++i )				\
+		{							\
+			*p++ = (unsigned char) v[i];			\
+			*p++ = (unsigned char)( v[i] >> 8 );		\
+		}							\
+	} else {							\
+		p += (nv) * Log_DltN__ ## name;				\
+		if ( !Log_DltSeq__ ## name ) p += (nv);			\
+		for ( i = 0; i < (nv); ++i )				\
+		{							\
+			d = (v[i] - Log_DltPrev__ ## name [i]) & 0xFFFF;\
+			if ( d > 0x7F && d < 0xFF80 )			\
+			{ /* difference does not fit */			\
+				Log_DltKey__ ## name = 1;		\
+				if ( !Log_DltN__ ## name )		\
+					return Log_DeltaPut ## name ( v );\
+				Log_DeltaCommit ## name ();		\
+				return 0;				\
+			}						\
+			p[i] = (unsigned char) d;			\
+		}							\
+	}								\
+	for ( i = 0; i < (nv); ++i ) Log_DltPrev__ ## name [i] = v[i];	\
+	if ( ++ Log_DltN__ ## name == ( Log_DltSeq__ ## name		\
+			? Log_DeltaCap( rec_size, nv )			\
+			: Log_DeltaKeyCap( rec_size, nv ) ) )		\
+		Log_DeltaCommit ## name ();				\
+	return 1;							\
+}									\
+									\
+void									\
+Log_DeltaCommit ## name ( void )					\
+{									\
+	unsigned char * p;						\
+	if ( Log_DltBusy__ ## name || !Log_DltN__ ## name ) return;	\
+	p = Log_DltRec__ ## name;					\
+	p[0] = Log_DltN__ ## name;					\
+	p += 1 + (nv) * Log_DltN__ ## name;				\
+	if ( !Log_DltSeq__ ## name ) p += (nv);				\
+	while ( p != Log_DltRec__ ## name + (rec_size)-1 ) *p++ = 0;	\
+	*p = Log_DltSeq__ ## name ? Log_DltSeq__ ## name : LOG_DELTA_KEY;\
+	Log_DltBusy__ ## name = 1;					\
+}									\
+									\
+unsigned char								\
+Log_DeltaFlush ## name ( void )						\
+{									\
+	if ( !Log_DltBusy__ ## name )					\
+		return Log_NoblockingWrite ## name ( 0 );		\
+	if ( !Log_NoblockingWrite ## name ( Log_DltRec__ ## name ) )	\
+		return 0;						\
+	Log_DltBusy__ ## name = 0;					\
+	Log_DltN__ ## name = 0;						\
+	if ( ++ Log_DltSeq__ ## name == (every) )			\
+		Log_DltSeq__ ## name = 0;				\
+	return 0;							\
+}									\
+									\
+/* number of samples in rec (0 if record is broken) */			\
+static unsigned char							\
+Log_DltCount__ ## name ( const unsigned char * rec )			\
+{									\
+	unsigned char t = rec[(rec_size)-1];				\
+	unsigned char n = rec[0];					\
+	if ( t == LOG_DELTA_KEY )					\
+		return ( n <= Log_DeltaKeyCap( rec_size, nv ) ) ? n : 0;\
+	if ( !t || t >= (every) ) return 0;				\
+	return ( n <= Log_DeltaCap( rec_size, nv ) ) ? n : 0;		\
+}									\
+									\
+/* find values before record Log_DltRRec__ ('current record') by	\
+   its chain from checkpoint; return 0 if chain is broken */		\
+static unsigned char							\
+Log_DltSync__ ## name ( void )						\
+{									\
+	unsigned char t[rec_size];					\
+	unsigned int b[nv];						\
+	unsigned char cur = Log_State__ ## name .read;			\
+	unsigned char s = Log_DltRRec__ ## name [(rec_size)-1];		\
+	unsigned char k;						\
+	if ( !Log_DltCount__ ## name ( Log_DltRRec__ ## name ) ) return 0;\
+	if ( s == LOG_DELTA_KEY ) return 1;				\
+	for ( k = s; k--; )						\
+	{ /* back to checkpoint */					\
+		if ( !Log_ReadPrev ## name ( t )			\
+			|| t[(rec_size)-1] != (k ? k : LOG_DELTA_KEY)	\
+			|| !Log_DltCount__ ## name ( t ) )		\
+		{							\
+			Log_State__ ## name .read = cur;		\
+			return 0;					\
+		}							\
+	}								\
+	Log_DeltaDecode( b, t, (nv), 1, t[0] - 1 );			\
+	while ( ++k < s - 1 )						\
+	{ /* forward to the record */					\
+		Log_ReadNext ## name ( t );				\
+		Log_DeltaDecode( b, t, (nv), 0, t[0] - 1 );		\
+	}								\
+	Log_State__ ## name .read = cur;				\
+	for ( k = 0; k < (nv); ++k ) Log_DltBase__ ## name [k] = b[k];	\
+	return 1;							\
+}									\
+									\
+/* the first (fwd) or the last sample of decodable record from the	\
+   'current record' (it is in Log_DltRRec__) in direction of fwd */	\
+static unsigned char							\
+Log_DltSeek__ ## name ( unsigned int * dst, unsigned char fwd )		\
+{									\
+	unsigned char * rec = Log_DltRRec__ ## name;			\
+	unsigned char i;						\
+	while ( !Log_DltSync__ ## name () )				\
+	{ /* records of broken chain after this one are broken too */	\
+		if ( fwd ) {						\
+			do {						\
+				if ( !Log_ReadNext ## name ( rec ) ) return 0;\
+			} while ( rec[(rec_size)-1] != LOG_DELTA_KEY );	\
+			continue;					\
+		}							\
+		/* and before it (if it is not broken itself) */	\
+		i = Log_DltCount__ ## name ( rec )			\
+			? rec[(rec_size)-1] : LOG_DELTA_KEY;		\
+		for ( ;; )						\
+		{							\
+			if ( !Log_ReadPrev ## name ( rec ) ) return 0;	\
+			if ( i < 2 || i == LOG_DELTA_KEY		\
+				|| rec[(rec_size)-1] != i - 1		\
+				|| !Log_DltCount__ ## name ( rec ) )	\
+				break;					\
+			--i;						\
+		}							\
+	}								\
+	Log_DltCur__ ## name = Log_State__ ## name .read;		\
+	Log_DltIdx__ ## name = fwd ? 0 : rec[0] - 1;			\
+	for ( i = 0; i < (nv); ++i )					\
+		Log_DltVal__ ## name [i] = Log_DltBase__ ## name [i];	\
+	Log_DeltaDecode( Log_DltVal__ ## name, rec, (nv),		\
+		rec[(rec_size)-1] == LOG_DELTA_KEY, Log_DltIdx__ ## name );\
+	for ( i = 0; i < (nv); ++i ) dst[i] = Log_DltVal__ ## name [i];	\
+	return 1;							\
+}									\
+									\
+unsigned char								\
+Log_DeltaReadFirst ## name ( unsigned int * dst )			\
+{									\
+	Log_ReadFirst ## name ( Log_DltRRec__ ## name );		\
+	return Log_DltSeek__ ## name ( dst, 1 );			\
+}									\
+									\
+unsigned char								\
+Log_DeltaReadLast ## name ( unsigned int * dst )			\
+{									\
+	Log_ReadLast ## name ( Log_DltRRec__ ## name );			\
+	return Log_DltSeek__ ## name ( dst, 0 );			\
+}									\
+									\
+unsigned char								\
+Log_DeltaReadNext ## name ( unsigned int * dst )			\
+{									\
+	unsigned char * rec = Log_DltRRec__ ## name;			\
+	unsigned char t[rec_size];					\
+	unsigned char i = Log_DltIdx__ ## name;				\
+	if ( ++i < rec[0] )						\
+	{ /* the next sample of record */				\
+		Log_DltIdx__ ## name = i;				\
+		if ( rec[(rec_size)-1] == LOG_DELTA_KEY ) ++i;		\
+		Log_DeltaStep( Log_DltVal__ ## name, rec + 1 + (nv) * i, (nv) );\
+		for ( i = 0; i < (nv); ++i ) dst[i] = Log_DltVal__ ## name [i];\
+		return 1;						\
+	}								\
+	Log_State__ ## name .read = Log_DltCur__ ## name;		\
+	if ( !Log_ReadNext ## name ( t ) ) return 0;			\
+	i = rec[(rec_size)-1];						\
+	i = (i == LOG_DELTA_KEY) ? 1 : i + 1;				\
+	if ( t[(rec_size)-1] == i && Log_DltCount__ ## name ( t ) )	\
+	{ /* the next record of chain */				\
+		for ( i = 0; i < (nv); ++i )				\
+			Log_DltBase__ ## name [i] = Log_DltVal__ ## name [i];\
+		for ( i = 0; i < (rec_size); ++i ) rec[i] = t[i];	\
+		Log_DltCur__ ## name = Log_State__ ## name .read;	\
+		Log_DltIdx__ ## name = 0;				\
+		Log_DeltaStep( Log_DltVal__ ## name, rec + 1, (nv) );	\
+		for ( i = 0; i < (nv); ++i ) dst[i] = Log_DltVal__ ## name [i];\
+		return 1;						\
+	}								\
+	for ( i = 0; i < (rec_size); ++i ) rec[i] = t[i];		\
+	return Log_DltSeek__ ## name ( dst, 1 );			\
+}									\
+									\
+unsigned char								\
+Log_DeltaReadPrev ## name ( unsigned int * dst )			\
+{									\
+	unsigned char * rec = Log_DltRRec__ ## name;			\
+	unsigned char i;						\
+	if ( Log_DltIdx__ ## name )					\
+	{ /* the previous sample of record */				\
+		-- Log_DltIdx__ ## name;				\
+		for ( i = 0; i < (nv); ++i )				\
+			Log_DltVal__ ## name [i] = Log_DltBase__ ## name [i];\
+		Log_DeltaDecode( Log_DltVal__ ## name, rec, (nv),	\
+			rec[(rec_size)-1] == LOG_DELTA_KEY,		\
+			Log_DltIdx__ ## name );				\
+		for ( i = 0; i < (nv); ++i ) dst[i] = Log_DltVal__ ## name [i];\
+		return 1;						\
+	}								\
+	Log_State__ ## name .read = Log_DltCur__ ## name;		\
+	if ( Log_ReadPrev ## name ( rec ) && Log_DltSeek__ ## name ( dst, 0 ) )\
+		return 1;						\
+	/* no decodable sample before: restore the 'current sample' */	\
+	Log_State__ ## name .read = Log_DltCur__ ## name;		\
+	Log_ReadCur ## name ( rec );					\
+	return 0;							\
+}
+
+
+/* End of file  ee-logs-delta.h */
@@ -0,0 +1,105 @@
+/* ee-logs-dict.h */
+/*
+ Dictionary of event codes for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Records store one byte index of event in dictionary instead of
+	two byte code of event.  Dictionary is made at compile time
+	from list of events:
+
+	#define MY_EVENTS( E, d )					\
+		E( d, RESET,    0x0001 )				\
+		E( d, OVERTEMP, 0x1203 )				\
+		E( d, LOWBAT,   0x2010 )
+
+	DECLARE_LOG_EVENT_DICT( Ev, MY_EVENTS )
+	LOG_EVENT_DICT( Ev, MY_EVENTS )
+
+	Index of event is the number of event in the list (from 0);
+	if the index is stored in the last byte of record then list
+	must have no more than 127 events (bit 7 of the last byte is
+	used by logger).
+
+	Host decoder (tools/ee-logs-decode.c) expands indexes with
+	dictionary file: one line for every event of the list, in
+	order of the list: CODE (in C notation) and NAME.
+
+
+ Define these macros and functions:
+
+ DECLARE_LOG_EVENT_DICT( DICT, LIST )
+	declare dictionary DICT of events from LIST (see above);
+	declares enum constants Log_Ev_DICT_NAME (index of event NAME)
+	and Log_EvCount_DICT (number of events in dictionary)
+
+ LOG_EVENT_DICT( DICT, LIST )
+	define dictionary DICT (after its declaration)
+
+	One must declare dictionary in every file where it is used,
+	but define only one time.
+
+ Log_EvIndex( DICT, CODE )
+	return index of event with code CODE;
+	return LOG_EV_NONE if there is no such event in DICT
+
+ Log_EvCode( DICT, INDEX )
+	return code of event with index INDEX
+	(INDEX must be less than Log_EvCount_DICT)
+
+*/
+
+
+#define LOG_EV_NONE	((unsigned char)0xFF)
+
+
+#define Log_EvEnum__( d, n, c )		Log_Ev_ ## d ## _ ## n,
+#define Log_EvCase__( d, n, c )		case (c): return Log_Ev_ ## d ## _ ## n;
+#define Log_EvCodeOf__( d, n, c )	(c),
+
+
+#define DECLARE_LOG_EVENT_DICT( dict, list )				\
+									\
+enum { list( Log_EvEnum__, dict ) Log_EvCount_ ## dict };		\
+									\
+extern const unsigned int Log_EvCodes__ ## dict [];			\
+									\
+static inline unsigned char						\
+Log_EvIndex ## dict ( unsigned int code )				\
+{									\
+	switch ( code )							\
+	{								\
+		list( Log_EvCase__, dict )				\
+	}								\
+	return LOG_EV_NONE;						\
+}
+
+
+#define Log_EvIndex( dict, code )	Log_EvIndex ## dict ( code )
+#define Log_EvCode( dict, index )	( Log_EvCodes__ ## dict [index] )
+
+
+#define LOG_EVENT_DICT( dict, list )					\
+									\
+const unsigned int Log_EvCodes__ ## dict [] = {				\
+	list( Log_EvCodeOf__, dict )					\
+};
+
+
+/* End of file  ee-logs-dict.h */
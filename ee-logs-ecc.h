@@ -0,0 +1,271 @@
+/* ee-logs-ecc.h */
+/*
+ Error correction (SECDED) of records for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Record is LOG_ECC_DATA( REC_SIZE ) bytes of data and check bits
+	of Hamming code with overall parity (single error correction,
+	double error detection):
+		REC_SIZE <= 5:	bits 0..5 of the last byte are syndrome,
+				bit 6 is parity;
+		REC_SIZE > 5:	byte REC_SIZE-2 and bits 0..5 of the last
+				byte are syndrome, bit 6 is parity.
+	Bit 7 of the last byte is the flag of ee-logs.h (it is not
+	protected).
+
+	Bit B of data byte K has code K*16 + C[B], where C[] are
+	different 4-bit numbers with two and more bits (3, 5, 6, 7,
+	9, 10, 11, 12), so a byte adds to syndrome a value from two
+	tables of 16 entries (for its nibbles) and K*16 if number of
+	its set bits is odd; check bits are computed by bytes while a
+	record is made (Log_EccByte) or for whole record
+	(Log_EccSeal).  Syndrome of read record with one wrong bit is
+	the code of this bit (data bit), a power of 2 (check bit) or 0
+	(parity bit) and the bit is corrected inline.
+
+	Check bits use the place of CRC7 of ee-logs-mirror.h, so ECC
+	and the mirror are not used for the same log.
+
+
+ Define these macros and functions:
+
+ LOG_ECC_DATA( REC_SIZE )
+	number of bytes of data of record (REC_SIZE-1 or REC_SIZE-2)
+
+ struct Log_Ecc, Log_EccStart( struct Log_Ecc * E ),
+ Log_EccByte( struct Log_Ecc * E, unsigned char K, unsigned char V )
+	compute check bits by bytes: V is data byte K of record
+
+ Log_EccPut( struct Log_Ecc * E, void * REC, unsigned char REC_SIZE )
+	put computed check bits into record REC
+
+ DECLARE_LOG_ECC( NAME )
+	declare ECC of log NAME
+
+ LOG_ECC( NAME, REC_SIZE )
+	define ECC of log NAME (log must be defined by
+	LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it in the
+	same file), 2 <= REC_SIZE
+
+ Log_EccSeal( NAME, void * REC )
+	put check bits into record REC before Log_NoblockingWrite or
+	Log_Append (bit 7 of its last byte is not changed)
+
+ Log_EccFix( NAME, void * REC )
+	check and correct read record REC;
+	return LOG_ECC_OK if the record is right, LOG_ECC_FIXED if
+	one wrong bit is corrected, LOG_ECC_BAD if the record has two
+	and more wrong bits
+
+ Log_EccFirst( NAME, void * DST ), Log_EccLast( NAME, void * DST )
+	read the first (the last) record of log NAME as Log_ReadFirst
+	(Log_ReadLast) does and correct it;
+	return as Log_EccFix
+
+ Log_EccNext( NAME, void * DST ), Log_EccPrev( NAME, void * DST )
+	read the next (the previous) record as Log_ReadNext
+	(Log_ReadPrev) does and correct it;
+	return 0 if there is no such record, else return as Log_EccFix
+
+
+ Example:
+
+	DECLARE_LOGGER( Ev, 100, 8, 0 )
+	DECLARE_LOG_ECC( Ev )
+	LOGGER( Ev, 100, 8, 0 )
+	LOG_ECC( Ev, 8 )			-- 6 bytes of data
+
+	Log_EccSeal( Ev, rec ); Log_NoblockingWrite( Ev, rec );
+	...
+	if ( Log_EccLast( Ev, rec ) == LOG_ECC_BAD ) ...
+
+*/
+
+
+#ifndef EE_LOGS_ECC_H
+#define EE_LOGS_ECC_H
+
+#define LOG_ECC_DATA( rec_size )					\
+	( (rec_size) <= 5 ? (rec_size)-1 : (rec_size)-2 )
+
+enum { LOG_ECC_OK = 1, LOG_ECC_FIXED, LOG_ECC_BAD };
+
+struct Log_Ecc {
+	unsigned int syn;		/* syndrome */
+	unsigned char par;		/* parity of data */
+};
+
+/* syndromes of low and high nibbles of byte */
+static const unsigned char Log_EccLo[16] = {
+	0, 3, 5, 6, 6, 5, 3, 0, 7, 4, 2, 1, 1, 2, 4, 7
+};
+static const unsigned char Log_EccHi[16] = {
+	0, 9, 10, 3, 11, 2, 1, 8, 12, 5, 6, 15, 7, 14, 13, 4
+};
+
+/* number of bit of byte with code c (0..15) of syndrome, 8: no bit */
+static const unsigned char Log_EccBit[16] = {
+	8, 8, 8, 0, 8, 1, 2, 3, 8, 4, 5, 6, 7, 8, 8, 8
+};
+
+/* parity of byte v */
+#define Log_EccPar( v )							\
+	( ( 0x6996u >> (((v) ^ ((v) >> 4)) & 15) ) & 1 )
+
+static inline void
+Log_EccStart( struct Log_Ecc * e )
+{
+	e->syn = 0;
+	e->par = 0;
+}
+
+static inline void
+Log_EccByte( struct Log_Ecc * e, unsigned char k, unsigned char v )
+{
+	unsigned char p = Log_EccPar( v );
+	e->syn ^= Log_EccLo[v & 15] ^ Log_EccHi[v >> 4];
+	if ( p ) e->syn ^= (unsigned int) k << 4;
+	e->par ^= p;
+}
+
+/* check bits of record r of size n */
+static inline void
+Log_EccPut( struct Log_Ecc * e, unsigned char * r, unsigned char n )
+{
+	unsigned int s = e->syn;
+	unsigned char p = e->par;
+	if ( n > 5 )
+	{
+		r[n-2] = (unsigned char) s;
+		p ^= Log_EccPar( (unsigned char) s );
+		s >>= 8;
+	}
+	p ^= Log_EccPar( (unsigned char) s );
+	r[n-1] = (r[n-1] & 0x80) | (unsigned char) s
+		| (unsigned char)( p << 6 );
+}
+
+/* check and correct record r of size n */
+static inline unsigned char
+Log_EccCheck( unsigned char * r, unsigned char n )
+{
+	struct Log_Ecc e;
+	unsigned char d = LOG_ECC_DATA( n );
+	unsigned char k, b, t = r[n-1] & 0x3F;
+	unsigned int s = t;
+	Log_EccStart( &e );
+	for ( k = 0; k < d; ++k ) Log_EccByte( &e, k, r[k] );
+	e.par ^= Log_EccPar( t ) ^ ((r[n-1] >> 6) & 1);
+	if ( n > 5 )
+	{
+		s = (s << 8) | r[n-2];
+		e.par ^= Log_EccPar( r[n-2] );
+	}
+	s ^= e.syn;
+	if ( !e.par ) return s ? LOG_ECC_BAD : LOG_ECC_OK;
+	if ( !s )
+		r[n-1] ^= 0x40;				/* parity bit */
+	else if ( !(s & (s - 1)) )
+	{ /* check bit */
+		if ( n > 5 && s < 0x100 ) r[n-2] ^= (unsigned char) s;
+		else r[n-1] ^= (unsigned char)( n > 5 ? s >> 8 : s );
+	} else {
+		k = (unsigned char)( s >> 4 );
+		b = Log_EccBit[s & 15];
+		if ( (s >> 4) >= d || b == 8 ) return LOG_ECC_BAD;
+		r[k] ^= (unsigned char)( 1 << b );
+	}
+	return LOG_ECC_FIXED;
+}
+
+#endif /* EE_LOGS_ECC_H */
+
+
+#define DECLARE_LOG_ECC( name )						\
+									\
+void Log_EccSeal ## name ( unsigned char * rec );			\
+unsigned char Log_EccFix ## name ( unsigned char * rec );		\
+unsigned char Log_EccFirst ## name ( unsigned char * dst );		\
+unsigned char Log_EccLast ## name ( unsigned char * dst );		\
+unsigned char Log_EccNext ## name ( unsigned char * dst );		\
+unsigned char Log_EccPrev ## name ( unsigned char * dst );
+
+
+#define Log_EccSeal( name, rec )	Log_EccSeal ## name ( rec )
+#define Log_EccFix( name, rec )		Log_EccFix ## name ( rec )
+#define Log_EccFirst( name, dst )	Log_EccFirst ## name ( dst )
+#define Log_EccLast( name, dst )	Log_EccLast ## name ( dst )
+#define Log_EccNext( name, dst )	Log_EccNext ## name ( dst )
+#define Log_EccPrev( name, dst )	Log_EccPrev ## name ( dst )
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_ECC( name, rec_size )					\
+									\
+typedef char Log_EccFits__ ## name [ (rec_size) >= 2 ? 1 : -1 ];	\
+									\
+void									\
+Log_EccSeal ## name ( unsigned char * rec )				\
+{									\
+	struct Log_Ecc e;						\
+	unsigned char k = 0;						\
+	Log_EccStart( &e );						\
+	for ( ; k < LOG_ECC_DATA( rec_size ); ++k )			\
+		Log_EccByte( &e, k, rec[k] );				\
+	Log_EccPut( &e, rec, (rec_size) );				\
+}									\
+									\
+unsigned char								\
+Log_EccFix ## name ( unsigned char * rec )				\
+{									\
+	return Log_EccCheck( rec, (rec_size) );				\
+}									\
+									\
+unsigned char								\
+Log_EccFirst ## name ( unsigned char * dst )				\
+{									\
+	Log_ReadFirst ## name ( dst );					\
+	return Log_EccCheck( dst, (rec_size) );				\
+}									\
+									\
+unsigned char								\
+Log_EccLast ## name ( unsigned char * dst )				\
+{									\
+	Log_ReadLast ## name ( dst );					\
+	return Log_EccCheck( dst, (rec_size) );				\
+}									\
+									\
+unsigned char								\
+Log_EccNext ## name ( unsigned char * dst )				\
+{									\
+	if ( !Log_ReadNext ## name ( dst ) ) return 0;			\
+	return Log_EccCheck( dst, (rec_size) );				\
+}									\
+									\
+unsigned char								\
+Log_EccPrev ## name ( unsigned char * dst )				\
+{									\
+	if ( !Log_ReadPrev ## name ( dst ) ) return 0;			\
+	return Log_EccCheck( dst, (rec_size) );				\
+}
+
+
+/* End of file  ee-logs-ecc.h */
@@ -0,0 +1,308 @@
+/* ee-logs-export.h */
+/*
+ Export of logs over UART for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	All records of log (from the oldest one) are sent in frames
+	of up to PER_FRAME records:
+
+		LOG_EXP_SOF, SEQ, N, REC_SIZE, CHK, N records, CRC (2 bytes)
+
+	SEQ is number of frame (modulo 256), the last frame has N = 0.
+	CHK is ~(SEQ ^ N ^ REC_SIZE): receiver drops false start of
+	frame (byte LOG_EXP_SOF in records) without waiting its end.
+	CRC is CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF)
+	of bytes from SEQ to the last byte of records, high byte first.
+
+	Receiver answers by two bytes:
+		LOG_EXP_ACK, SEQ -- all frames before SEQ are received;
+		LOG_EXP_NAK, SEQ -- frame SEQ is lost or broken.
+
+	Sender has up to WINDOW frames without answer (sliding window).
+	On LOG_EXP_NAK (or Log_ExportTimeout) sender returns to frame
+	SEQ (go-back-N): records of frames are read again from EEPROM,
+	so frames are not kept in RAM.
+
+	Records are sent from a buffer while the next record is read
+	from EEPROM to the second buffer, a byte for every sent byte
+	(only the first record of frame is read at once), so reading
+	of EEPROM overlaps transmission of UART.
+
+	Records must not be appended to log while export is in progress.
+
+
+ Used extern functions:
+
+ unsigned char isUARTfree( void )
+	return not 0, if UART can accept a byte for transmission
+
+ void WriteUART( unsigned char BT )
+	put byte BT for transmission, return immediate
+
+ unsigned char isUARTdata( void )
+	return not 0, if UART has a received byte
+
+ unsigned char ReadUART( void )
+	return received byte
+
+
+ Define these macros and functions:
+
+ DECLARE_LOG_EXPORT( NAME )
+	declare export of log NAME
+
+ LOG_EXPORT( NAME, RECS, REC_SIZE, START_ADDR, PER_FRAME, WINDOW )
+	define export of log NAME (log must be defined by
+	LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it in the
+	same file); PER_FRAME (1..255) records in frame, WINDOW
+	(power of 2, 1..128) frames without answer
+
+ Log_ExportStart( NAME )
+	start export of log NAME
+
+ Log_ExportPoll( NAME )
+	send and receive bytes while UART is free and has data;
+	call this function periodical;
+	return not 0 if export is terminated (all frames are
+	acknowledged) or is not started
+
+ Log_ExportTimeout( NAME )
+	no answer for too long time: send again all frames without
+	answer
+
+*/
+
+
+#ifndef EE_LOGS_EXPORT_H
+#define EE_LOGS_EXPORT_H
+
+#define LOG_EXP_SOF	((unsigned char)0xA5)
+#define LOG_EXP_ACK	((unsigned char)0x06)
+#define LOG_EXP_NAK	((unsigned char)0x15)
+
+/* states of sender */
+#define LOG_EXP_IDLE	0	/* export is terminated */
+#define LOG_EXP_FRAME	1	/* begin the next frame */
+#define LOG_EXP_HDR	2	/* send header */
+#define LOG_EXP_DATA	3	/* send records */
+#define LOG_EXP_CRC	4	/* send CRC */
+#define LOG_EXP_WAIT	5	/* wait answer */
+
+static inline unsigned int
+Log_Crc16( unsigned int crc, unsigned char b )
+{
+	unsigned char i;
+	crc ^= (unsigned int) b << 8;
+	for ( i = 0; i < 8; ++i )
+		crc = ( crc & 0x8000 ) ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc & 0xFFFF;
+}
+
+#endif /* EE_LOGS_EXPORT_H */
+
+
+#define DECLARE_LOG_EXPORT( name )					\
+									\
+void Log_ExportStart ## name ( void );					\
+unsigned char Log_ExportPoll ## name ( void );				\
+void Log_ExportTimeout ## name ( void );
+
+
+#define Log_ExportStart( name )		Log_ExportStart ## name ()
+#define Log_ExportPoll( name )		Log_ExportPoll ## name ()
+#define Log_ExportTimeout( name )	Log_ExportTimeout ## name ()
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_EXPORT( name, recs, rec_size, start_addr,			\
+		per_frame, window )					\
+									\
+static unsigned char Log_ExpBuf__ ## name [2][rec_size];		\
+static unsigned char Log_ExpFirst__ ## name [window]; /* of frames */	\
+static unsigned char Log_ExpSlot__ ## name;	/* next record to send */\
+static unsigned char Log_ExpBase__ ## name;	/* the first frame	\
+						   without answer */	\
+static unsigned char Log_ExpSeq__ ## name;	/* frame being sent */	\
+static unsigned char Log_ExpState__ ## name;				\
+static unsigned char Log_ExpEnd__ ## name;	/* last frame is sent */\
+static unsigned char Log_ExpN__ ## name;	/* records in frame */	\
+static unsigned char Log_ExpRec__ ## name;	/* record in frame */	\
+static unsigned char Log_ExpB__ ## name;	/* buffer being sent */	\
+static unsigned char Log_ExpI__ ## name;	/* byte being sent */	\
+static unsigned char Log_ExpAns__ ## name;	/* answer (first byte) */\
+static unsigned int Log_ExpCrc__ ## name;				\
+									\
+/* go back to frame seq */						\
+static void								\
+Log_ExpBack__ ## name ( unsigned char seq )				\
+{									\
+	if ( seq != Log_ExpSeq__ ## name				\
+		|| ( Log_ExpState__ ## name != LOG_EXP_FRAME		\
+		&& Log_ExpState__ ## name != LOG_EXP_WAIT ) )		\
+	{ /* frame seq is started */					\
+		Log_ExpSeq__ ## name = seq;				\
+		Log_ExpSlot__ ## name =					\
+			Log_ExpFirst__ ## name [seq % (window)];	\
+	}								\
+	Log_ExpEnd__ ## name = 0;					\
+	Log_ExpState__ ## name = LOG_EXP_FRAME;				\
+}									\
+									\
+void									\
+Log_ExportStart ## name ( void )					\
+{									\
+	unsigned char r = Log_State__ ## name .rec;			\
+	Log_IncRec( r, recs );			/* the first record */	\
+	Log_ExpSlot__ ## name = r;					\
+	Log_ExpBase__ ## name = 0;					\
+	Log_ExpSeq__ ## name = 0;					\
+	Log_ExpEnd__ ## name = 0;					\
+	Log_ExpAns__ ## name = 0;					\
+	Log_ExpState__ ## name = LOG_EXP_FRAME;				\
+}									\
+									\
+void									\
+Log_ExportTimeout ## name ( void )					\
+{									\
+	if ( Log_ExpState__ ## name != LOG_EXP_IDLE )			\
+		Log_ExpBack__ ## name ( Log_ExpBase__ ## name );	\
+}									\
+									\
+unsigned char								\
+Log_ExportPoll ## name ( void )						\
+{									\
+	unsigned char b, n, i;						\
+	while ( isUARTdata() )						\
+	{ /* answers of receiver */					\
+		b = ReadUART();						\
+		if ( !Log_ExpAns__ ## name )				\
+		{							\
+			if ( b == LOG_EXP_ACK || b == LOG_EXP_NAK )	\
+				Log_ExpAns__ ## name = b;		\
+			continue;					\
+		}							\
+		n = Log_ExpSeq__ ## name - Log_ExpBase__ ## name;	\
+		if ( Log_ExpState__ ## name != LOG_EXP_IDLE		\
+			&& (unsigned char)(b - Log_ExpBase__ ## name) <= n )\
+		{							\
+			Log_ExpBase__ ## name = b;			\
+			if ( Log_ExpAns__ ## name == LOG_EXP_NAK )	\
+				Log_ExpBack__ ## name ( b );		\
+			else if ( Log_ExpState__ ## name == LOG_EXP_WAIT )\
+				Log_ExpState__ ## name = LOG_EXP_FRAME;	\
+			if ( Log_ExpEnd__ ## name			\
+				&& b == Log_ExpSeq__ ## name )		\
+				Log_ExpState__ ## name = LOG_EXP_IDLE;	\
+		}							\
+		Log_ExpAns__ ## name = 0;				\
+	}								\
+									\
+	while ( Log_ExpState__ ## name != LOG_EXP_IDLE )		\
+	{								\
+		if ( Log_ExpState__ ## name == LOG_EXP_FRAME )		\
+		{ /* the next frame: count its records */		\
+			if ( Log_ExpEnd__ ## name			\
+				|| (unsigned char)(Log_ExpSeq__ ## name	\
+				- Log_ExpBase__ ## name) >= (window) )	\
+			{						\
+				Log_ExpState__ ## name = LOG_EXP_WAIT;	\
+				break;					\
+			}						\
+			b = Log_ExpSlot__ ## name;			\
+			Log_ExpFirst__ ## name [Log_ExpSeq__ ## name % (window)] = b;\
+			n = Log_State__ ## name .rec - b;		\
+			if ( Log_State__ ## name .rec < b ) n += (recs);\
+			if ( n > (per_frame) ) n = (per_frame);		\
+			Log_ExpN__ ## name = n;				\
+			Log_ExpRec__ ## name = 0;			\
+			Log_ExpB__ ## name = 0;				\
+			if ( n ) Log_ReadRec__ ## name ( Log_ExpBuf__ ## name [0], b );\
+			Log_ExpI__ ## name = 0;				\
+			Log_ExpCrc__ ## name = 0xFFFF;			\
+			Log_ExpState__ ## name = LOG_EXP_HDR;		\
+		}							\
+		if ( Log_ExpState__ ## name == LOG_EXP_WAIT		\
+			|| !isUARTfree() ) break;			\
+		switch ( Log_ExpState__ ## name )			\
+		{							\
+		case LOG_EXP_HDR:					\
+			switch ( Log_ExpI__ ## name ++ )		\
+			{						\
+			case 0: WriteUART( LOG_EXP_SOF ); continue;	\
+			case 1: b = Log_ExpSeq__ ## name; break;	\
+			case 2: b = Log_ExpN__ ## name; break;		\
+			case 3: b = (rec_size); break;			\
+			default:					\
+				b = (unsigned char)( Log_ExpSeq__ ## name\
+					^ Log_ExpN__ ## name		\
+					^ (rec_size) ^ 0xFF );		\
+				Log_ExpI__ ## name = 0;			\
+				Log_ExpState__ ## name =		\
+					Log_ExpN__ ## name		\
+					? LOG_EXP_DATA : LOG_EXP_CRC;	\
+			}						\
+			break;						\
+		case LOG_EXP_DATA:					\
+			i = Log_ExpI__ ## name;				\
+			if ( Log_ExpRec__ ## name + 1 != Log_ExpN__ ## name )\
+			{ /* read byte i of the next record */		\
+				n = Log_ExpSlot__ ## name;		\
+				Log_IncRec( n, recs );			\
+				if ( !Log_BusAcquire() ) return 0; /* later */\
+				Log_ExpBuf__ ## name [Log_ExpB__ ## name ^ 1][i]\
+					= ReadEE( (void*)( i +		\
+					Log_RecAddr( start_addr, rec_size, n ) ) );\
+				Log_BusRelease();			\
+			}						\
+			b = Log_ExpBuf__ ## name [Log_ExpB__ ## name][i];\
+			if ( ++ i == (rec_size) )			\
+			{ /* the next record is read */			\
+				b &= (unsigned char)~LOG_FLAG_MASK;	\
+				i = 0;					\
+				n = Log_ExpSlot__ ## name;		\
+				Log_IncRec( n, recs );			\
+				Log_ExpSlot__ ## name = n;		\
+				Log_ExpB__ ## name ^= 1;		\
+				if ( ++ Log_ExpRec__ ## name == Log_ExpN__ ## name )\
+					Log_ExpState__ ## name = LOG_EXP_CRC;\
+			}						\
+			Log_ExpI__ ## name = i;				\
+			break;						\
+		default: /* LOG_EXP_CRC */				\
+			b = (unsigned char)( Log_ExpCrc__ ## name >> 8 );\
+			if ( Log_ExpI__ ## name ++ )			\
+			{						\
+				b = (unsigned char) Log_ExpCrc__ ## name;\
+				if ( !Log_ExpN__ ## name ) Log_ExpEnd__ ## name = 1;\
+				++ Log_ExpSeq__ ## name;		\
+				Log_ExpState__ ## name = LOG_EXP_FRAME;	\
+			}						\
+			WriteUART( b );					\
+			continue;					\
+		}							\
+		Log_ExpCrc__ ## name = Log_Crc16( Log_ExpCrc__ ## name, b );\
+		WriteUART( b );						\
+	}								\
+	return Log_ExpState__ ## name == LOG_EXP_IDLE;			\
+}
+
+
+/* End of file  ee-logs-export.h */
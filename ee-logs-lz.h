@@ -0,0 +1,476 @@
+/* ee-logs-lz.h */
+/*
+ Compression of records for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Records of user (of size USIZE) are collected in RAM into
+	a block of GROUP records.  Full block (group commit) is
+	compressed by LZ77 (LZSS) coder and written to log as a frame
+	of records of log.
+
+	Compressed stream is a sequence of groups: control byte and
+	8 tokens; bit K of control byte (from bit 0) is 1 if token K
+	is a match, else token K is a literal byte.  A match is two
+	bytes: offset (1..LOG_LZ_WINDOW) back in already decoded data
+	and length-3 (match has 3..258 bytes).
+
+	Frame is written to records of log (REC_SIZE bytes each):
+	bytes 0..REC_SIZE-2 of record are compressed stream (the first
+	byte of frame is the number of records of user in the block),
+	the last byte of record is the number of the record in frame
+	(modulo 64) with bit 6 set in the first record of frame.
+	Tail of the last record of frame is not used.
+
+	Encoder needs only the block (USIZE*GROUP bytes) and 34 bytes
+	of RAM, compressed bytes are made when writer asks them.  Search
+	of matches is cut to steps of LOG_LZ_STEP compares, so one call
+	of Log_LzFlush does not stay long (a record of frame is made by
+	some calls).
+	Decoder needs only destination buffer (USIZE*GROUP bytes)
+	and is fed by records of log one by one.
+
+
+ Configuration macros (define it before include this file):
+
+ LOG_LZ_WINDOW
+	max offset of match (1..255, default 255); smaller window
+	makes encoder faster and compression worse
+
+ LOG_LZ_STEP
+	bytes compared by one call of Log_LzFlush (1..65535, default
+	64); the last compared match may add LOG_LZ_MAXLEN compares
+
+
+ Define these macros and functions:
+
+ DECLARE_LOG_LZ( NAME )
+	declare compression of log NAME
+
+ LOG_LZ( NAME, REC_SIZE, USIZE, GROUP )
+	define compression of log NAME (log must be defined by
+	LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it
+	in the same file) for records of user of size USIZE;
+	GROUP (1 <= GROUP <= 255) records in block;
+	USIZE * GROUP must be not greater than 65535; a frame of not
+	compressed block (literals and control bytes) must fit in
+	RECS-1 records of log
+
+ Log_LzAppend( NAME, void * SRC )
+	put record of user (USIZE bytes) from address SRC to block;
+	return not 0 if the record is put;
+	return 0 if the block is full and is being written now
+
+ Log_LzCommit( NAME )
+	start writing of block even if it is not full
+
+ Log_LzFlush( NAME )
+	write compressed block to log; call this function periodical;
+	return not 0 if nothing is being written (as
+	Log_NoblockingWrite( NAME, 0 ))
+
+ Log_LzReadFirst( NAME, void * DST )
+ Log_LzReadLast( NAME, void * DST )
+ Log_LzReadNext( NAME, void * DST )
+ Log_LzReadPrev( NAME, void * DST )
+	read the first (last, next, previous) block of log NAME to
+	address DST (buffer must have USIZE*GROUP bytes);
+	return number of records of user in the block;
+	return 0 if there is no such block;
+	broken blocks (overwritten in part) are skipped
+
+*/
+
+
+#ifndef EE_LOGS_LZ_H
+#define EE_LOGS_LZ_H
+
+#ifndef LOG_LZ_WINDOW
+#define LOG_LZ_WINDOW	255
+#endif
+
+#ifndef LOG_LZ_STEP
+#define LOG_LZ_STEP	64
+#endif
+
+#define LOG_LZ_MINLEN	3
+#define LOG_LZ_MAXLEN	(255 + LOG_LZ_MINLEN)
+
+#define LOG_LZ_START	((unsigned char)0x40)	/* first record of frame */
+#define LOG_LZ_SEQ	((unsigned char)0x3F)
+
+
+struct Log_LzEnc {
+	const unsigned char * blk;
+	unsigned int pos;		/* next byte of block to encode */
+	unsigned int len;
+	unsigned int j;			/* next place of match of pos */
+	unsigned int ml;		/* the longest match of pos */
+	unsigned int step;		/* compares left in this call */
+	unsigned char mo;		/* offset of the match */
+	unsigned char m;		/* bit of token (0: no group) */
+	unsigned char w;		/* bytes of group which is made */
+	unsigned char buf[17];		/* control byte and 8 tokens */
+	unsigned char n;		/* bytes in buf */
+	unsigned char i;		/* next byte of buf */
+};
+
+struct Log_LzDec {
+	unsigned char * blk;
+	unsigned int pos;		/* next byte of block to decode */
+	unsigned int len;
+	unsigned int ctrl;		/* flags of tokens and stop bit */
+	unsigned char off;		/* offset of match (wait length) */
+};
+
+
+static inline void
+Log_LzEncInit( struct Log_LzEnc * z, const unsigned char * blk,
+		unsigned int len )
+{
+	z->blk = blk;
+	z->pos = 0;
+	z->len = len;
+	z->n = z->i = 0;
+	z->j = z->ml = 0;
+	z->mo = z->m = 0;
+}
+
+#define Log_LzEncDone( z )	( (z)->i == (z)->n && (z)->pos >= (z)->len )
+
+
+/* the first place of match of byte p (start of window) */
+#define Log_LzFrom( p )							\
+	( ( (p) > (LOG_LZ_WINDOW) ) ? (p) - (LOG_LZ_WINDOW) : 0 )
+
+/* encode next group of tokens to z->buf (z->step compares at most);
+   return 0 if the group is not made yet (continue it by next call) */
+static unsigned char
+Log_LzFill( struct Log_LzEnc * z )
+{
+	const unsigned char * b = z->blk;
+	unsigned int p = z->pos, j = z->j, ml = z->ml;
+	unsigned int k;
+	if ( !z->m )
+	{ /* start the group */
+		z->buf[0] = 0;
+		z->w = 1;
+		z->m = 1;
+		j = Log_LzFrom( p );
+		ml = 0;
+	}
+	while ( z->m && p < z->len )
+	{
+		for ( ; j < p; ++j )
+		{
+			if ( !z->step )
+			{
+				z->pos = p; z->j = j; z->ml = ml;
+				return 0;
+			}
+			--z->step;
+			if ( b[j] != b[p] ) continue;
+			k = 1;
+			while ( p + k < z->len && k < (LOG_LZ_MAXLEN)
+				&& b[j + k] == b[p + k] ) ++k;
+			z->step = ( z->step > k ) ? z->step - k : 0;
+			if ( k >= ml ) { ml = k; z->mo = (unsigned char)(p - j); }
+		}
+		if ( ml >= (LOG_LZ_MINLEN) )
+		{
+			z->buf[0] |= z->m;
+			z->buf[z->w++] = z->mo;
+			z->buf[z->w++] = (unsigned char)(ml - (LOG_LZ_MINLEN));
+			p += ml;
+		} else {
+			z->buf[z->w++] = b[p++];
+		}
+		z->m <<= 1;
+		j = Log_LzFrom( p );
+		ml = 0;
+	}
+	z->m = 0;
+	z->pos = p;
+	z->n = z->w;
+	z->i = 0;
+	return 1;
+}
+
+/* put up to n compressed bytes to dst (LOG_LZ_STEP compares at most);
+   return number of bytes (less than n if the block is encoded or the
+   compares are used) */
+static unsigned char
+Log_LzEncode( struct Log_LzEnc * z, unsigned char * dst, unsigned char n )
+{
+	unsigned char c = 0;
+	z->step = (LOG_LZ_STEP);
+	while ( c < n )
+	{
+		if ( z->i == z->n )
+		{
+			if ( z->pos >= z->len ) break;
+			if ( !Log_LzFill( z ) ) break;
+		}
+		dst[c++] = z->buf[z->i++];
+	}
+	return c;
+}
+
+
+static inline void
+Log_LzDecInit( struct Log_LzDec * d, unsigned char * blk, unsigned int len )
+{
+	d->blk = blk;
+	d->pos = 0;
+	d->len = len;
+	d->ctrl = 0;
+	d->off = 0;
+}
+
+/*
+	decode n compressed bytes from src;
+	return 0 if more bytes are needed;
+	return 1 if block is decoded;
+	return 2 if stream is broken
+*/
+static unsigned char
+Log_LzDecode( struct Log_LzDec * d, const unsigned char * src, unsigned char n )
+{
+	unsigned char * b = d->blk;
+	unsigned int p = d->pos;
+	unsigned int k;
+	unsigned char c;
+	if ( p >= d->len ) return 1;
+	while ( n-- )
+	{
+		c = *src++;
+		if ( d->off )
+		{ /* length of match */
+			if ( d->off > p ) return 2;
+			k = c + (LOG_LZ_MINLEN);
+			if ( k > d->len - p ) k = d->len - p;
+			do {
+				b[p] = b[p - d->off];
+				++p;
+			} while ( --k );
+			d->off = 0;
+			d->ctrl >>= 1;
+		} else if ( d->ctrl <= 1 ) {
+			d->ctrl = c | 0x100;
+			continue;
+		} else if ( d->ctrl & 1 ) {
+			if ( !c ) return 2;
+			d->off = c;
+			continue;
+		} else {
+			b[p++] = c;
+			d->ctrl >>= 1;
+		}
+		if ( p >= d->len ) { d->pos = p; return 1; }
+	}
+	d->pos = p;
+	return 0;
+}
+
+#endif /* EE_LOGS_LZ_H */
+
+
+
+#define DECLARE_LOG_LZ( name )						\
+									\
+unsigned char Log_LzAppend ## name ( const unsigned char * src );	\
+void Log_LzCommit ## name ( void );					\
+unsigned char Log_LzFlush ## name ( void );				\
+unsigned char Log_LzReadFirst ## name ( unsigned char * dst );		\
+unsigned char Log_LzReadLast ## name ( unsigned char * dst );		\
+unsigned char Log_LzReadNext ## name ( unsigned char * dst );		\
+unsigned char Log_LzReadPrev ## name ( unsigned char * dst );
+
+
+#define Log_LzAppend( name, src )	Log_LzAppend ## name ( src )
+#define Log_LzCommit( name )		Log_LzCommit ## name ()
+#define Log_LzFlush( name )		Log_LzFlush ## name ()
+#define Log_LzReadFirst( name, dst )	Log_LzReadFirst ## name ( dst )
+#define Log_LzReadLast( name, dst )	Log_LzReadLast ## name ( dst )
+#define Log_LzReadNext( name, dst )	Log_LzReadNext ## name ( dst )
+#define Log_LzReadPrev( name, dst )	Log_LzReadPrev ## name ( dst )
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_LZ( name, rec_size, usize, group )				\
+									\
+/* error here: frame of not compressed block is longer than log */	\
+typedef char Log_LzFits__ ## name					\
+	[ ( 1 + (usize) * (group) + ((usize) * (group) + 7) / 8		\
+		+ (rec_size) - 2 ) / ((rec_size) - 1)			\
+		<= Log_Recs__ ## name - 1 ? 1 : -1 ];			\
+									\
+static unsigned char Log_LzBlk__ ## name [(usize) * (group)];		\
+static unsigned char Log_LzCnt__ ## name;	/* records in block */	\
+static unsigned char Log_LzSeq__ ## name;	/* next record of frame */\
+static unsigned char Log_LzBusy__ ## name;	/* frame is written */	\
+static unsigned char Log_LzHave__ ## name;	/* Log_LzRec__ is made */\
+static unsigned char Log_LzPos__ ## name;	/* bytes of Log_LzRec__ */\
+static unsigned char Log_LzCur__ ## name;	/* start of read frame */\
+static struct Log_LzEnc Log_LzEnc__ ## name;				\
+static unsigned char Log_LzRec__ ## name [rec_size];			\
+									\
+unsigned char								\
+Log_LzAppend ## name ( const unsigned char * src )			\
+{									\
+	unsigned char * p;						\
+	unsigned int i = (usize);					\
+	if ( Log_LzBusy__ ## name ) return 0;				\
+	p = Log_LzBlk__ ## name + (usize) * Log_LzCnt__ ## name;	\
+	do {								\
+		*p++ = *src++;						\
+	} while ( --i );						\
+	if ( ++ Log_LzCnt__ ## name == (group) )			\
+		Log_LzCommit ## name ();				\
+	return 1;							\
+}									\
+									\
+void									\
+Log_LzCommit ## name ( void )						\
+{									\
+	if ( Log_LzBusy__ ## name || !Log_LzCnt__ ## name ) return;	\
+	Log_LzEncInit( &Log_LzEnc__ ## name, Log_LzBlk__ ## name,	\
+			(usize) * Log_LzCnt__ ## name );		\
+	Log_LzSeq__ ## name = 0;					\
+	Log_LzHave__ ## name = 0;					\
+	Log_LzPos__ ## name = 0;					\
+	Log_LzBusy__ ## name = 1;					\
+}									\
+									\
+unsigned char								\
+Log_LzFlush ## name ( void )						\
+{									\
+	unsigned char * p = Log_LzRec__ ## name;			\
+	unsigned char n;						\
+	if ( !Log_LzBusy__ ## name )					\
+		return Log_NoblockingWrite ## name ( 0 );		\
+	if ( !Log_LzHave__ ## name )					\
+	{ /* make the next record of frame (by some calls) */		\
+		n = Log_LzPos__ ## name;				\
+		if ( !Log_LzSeq__ ## name && !n )			\
+			p[n++] = Log_LzCnt__ ## name;			\
+		n += Log_LzEncode( &Log_LzEnc__ ## name, p + n,		\
+				(rec_size) - 1 - n );			\
+		Log_LzPos__ ## name = n;				\
+		if ( n < (rec_size) - 1					\
+			&& !Log_LzEncDone( &Log_LzEnc__ ## name ) )	\
+			return 0;					\
+		while ( n < (rec_size) - 1 ) p[n++] = 0;		\
+		p[n] = ( Log_LzSeq__ ## name )				\
+			? Log_LzSeq__ ## name & LOG_LZ_SEQ : LOG_LZ_START;\
+		Log_LzPos__ ## name = 0;				\
+		Log_LzHave__ ## name = 1;				\
+	}								\
+	if ( !Log_NoblockingWrite ## name ( Log_LzRec__ ## name ) )	\
+		return 0;						\
+	Log_LzHave__ ## name = 0;					\
+	++ Log_LzSeq__ ## name;						\
+	if ( Log_LzEncDone( &Log_LzEnc__ ## name ) )			\
+	{								\
+		Log_LzCnt__ ## name = 0;				\
+		Log_LzBusy__ ## name = 0;				\
+	}								\
+	return 0;							\
+}									\
+									\
+/* decode frame which first record is in rec (it is 'current record') */\
+static unsigned char							\
+Log_LzLoad__ ## name ( unsigned char * dst, unsigned char * rec )	\
+{									\
+	struct Log_LzDec d;						\
+	unsigned char n = rec[0];					\
+	unsigned char s = 0;						\
+	unsigned char r;						\
+	Log_LzCur__ ## name = Log_State__ ## name .read;		\
+	if ( !n || n > (group) ) return 0;				\
+	Log_LzDecInit( &d, dst, (usize) * n );				\
+	r = Log_LzDecode( &d, rec + 1, (rec_size) - 2 );		\
+	while ( !r )							\
+	{								\
+		if ( !Log_ReadNext ## name ( rec ) ) break;		\
+		if ( rec[(rec_size)-1] != (++s & LOG_LZ_SEQ) ) break;	\
+		r = Log_LzDecode( &d, rec, (rec_size) - 1 );		\
+	}								\
+	Log_State__ ## name .read = Log_LzCur__ ## name;		\
+	return ( r == 1 ) ? n : 0;					\
+}									\
+									\
+/* find frame from the 'current record' in direction of fwd */		\
+static unsigned char							\
+Log_LzSeek__ ## name ( unsigned char * dst, unsigned char * rec,	\
+			unsigned char fwd )				\
+{									\
+	unsigned char n;						\
+	for (;;)							\
+	{								\
+		if ( rec[(rec_size)-1] & LOG_LZ_START )			\
+		{							\
+			if ( (n = Log_LzLoad__ ## name ( dst, rec )) )	\
+				return n;				\
+		}							\
+		if ( fwd ) {						\
+			if ( !Log_ReadNext ## name ( rec ) ) return 0;	\
+		} else {						\
+			if ( !Log_ReadPrev ## name ( rec ) ) return 0;	\
+		}							\
+	}								\
+}									\
+									\
+unsigned char								\
+Log_LzReadFirst ## name ( unsigned char * dst )				\
+{									\
+	unsigned char rec[rec_size];					\
+	Log_ReadFirst ## name ( rec );					\
+	return Log_LzSeek__ ## name ( dst, rec, 1 );			\
+}									\
+									\
+unsigned char								\
+Log_LzReadLast ## name ( unsigned char * dst )				\
+{									\
+	unsigned char rec[rec_size];					\
+	Log_ReadLast ## name ( rec );					\
+	return Log_LzSeek__ ## name ( dst, rec, 0 );			\
+}									\
+									\
+unsigned char								\
+Log_LzReadNext ## name ( unsigned char * dst )				\
+{									\
+	unsigned char rec[rec_size];					\
+	Log_State__ ## name .read = Log_LzCur__ ## name;		\
+	if ( !Log_ReadNext ## name ( rec ) ) return 0;			\
+	return Log_LzSeek__ ## name ( dst, rec, 1 );			\
+}									\
+									\
+unsigned char								\
+Log_LzReadPrev ## name ( unsigned char * dst )				\
+{									\
+	unsigned char rec[rec_size];					\
+	Log_State__ ## name .read = Log_LzCur__ ## name;		\
+	if ( !Log_ReadPrev ## name ( rec ) ) return 0;			\
+	return Log_LzSeek__ ## name ( dst, rec, 0 );			\
+}
+
+
+/* End of file  ee-logs-lz.h */
@@ -0,0 +1,368 @@
+/* ee-logs-mirror.h */
+/*
+ Background mirror (second copy) of log for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Mirror is a ring of RECS slots at address MIRROR_ADDR (of the
+	same EEPROM or of other chip) with the same layout as the ring
+	of log.  Log_MirrorStep copies records of log to the mirror in
+	order of writing, one write cycle (a page, see LOG_PAGE_SIZE,
+	or the last byte of record with the flag) by a call; it works
+	only if EEPROM is free, so call it when EEPROM is not used by
+	other writers (for example, after Log_NoblockingWrite( NAME, 0 )
+	or Log_Flush returns not 0).  The mirror must lag behind the
+	log less than RECS records (if the log passes the mirror,
+	copying is restarted from the first record of log).
+
+	Records are validated by CRC7 (polynomial x^7 + x^3 + 1) of
+	the first REC_SIZE-1 bytes in bits 0..6 of the last byte of
+	record: Log_MirrorSeal puts it into a record before
+	Log_NoblockingWrite or Log_Append.  Log_MirrorFirst and others
+	read a record of log as Log_ReadFirst and others do; if the
+	record is not valid, the same record of the mirror is read if
+	it is copied after the last start of copying and its flag is
+	the flag of the record of log (so records of the previous pass
+	of ring are not used).
+
+
+ Used extern functions:
+
+	as ee-logs.h; the mirror on other chip uses the macros below
+
+
+ Configuration macros (define it before include this file):
+
+ LOG_MIRROR_READ( ADDR ), LOG_MIRROR_WRITE( ADDR, BT ),
+ LOG_MIRROR_FREE()
+	as ReadEE, WriteEE and isEEfree of ee-logs.h for the mirror
+	(default: ReadEE, WriteEE and isEEfree)
+
+ LOG_MIRROR_PAGE( ADDR, SRC, N )
+	as WriteEEPage of ee-logs.h for the mirror (default: WriteEEPage
+	if LOG_PAGE_SIZE is defined and LOG_MIRROR_WRITE is not defined);
+	if it is not defined, the mirror is written by bytes
+
+
+ Define these macros and functions:
+
+ DECLARE_LOG_MIRROR( NAME )
+	declare mirror of log NAME
+
+ LOG_MIRROR( NAME, RECS, REC_SIZE, MIRROR_ADDR )
+	define mirror of log NAME (log must be defined by
+	LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it in the
+	same file)
+
+ Log_MirrorInit( NAME )
+	find the first record of log which is not copied to the mirror
+	(compares records of log and of the mirror from the first one,
+	a damaged record of log is taken as copied if the record of the
+	mirror is valid; call it after Log_Init)
+
+ Log_MirrorStep( NAME )
+	no blocking copy records of log NAME to the mirror;
+	return not 0 if all records are copied
+
+ Log_MirrorSeal( NAME, void * REC )
+	put CRC7 into record REC (bit 7 of its last byte is not changed)
+
+ Log_MirrorFirst( NAME, void * DST ), Log_MirrorLast( NAME, void * DST )
+	read the first (the last) record of log NAME as Log_ReadFirst
+	(Log_ReadLast) does;
+	return LOG_MIRROR_MAIN if the record of log is valid,
+	LOG_MIRROR_COPY if the record of the mirror is read,
+	LOG_MIRROR_BAD if both are not valid (DST has the record of log)
+
+ Log_MirrorNext( NAME, void * DST ), Log_MirrorPrev( NAME, void * DST )
+	read the next (the previous) record as Log_ReadNext
+	(Log_ReadPrev) does;
+	return 0 if there is no such record, else return
+	as Log_MirrorFirst
+
+
+ Example (the mirror on the same EEPROM after the log):
+
+	DECLARE_LOGGER( Ev, 100, 8, 0 )
+	DECLARE_LOG_MIRROR( Ev )
+	LOGGER( Ev, 100, 8, 0 )
+	LOG_MIRROR( Ev, 100, 8, 800 )
+
+	Log_Init( Ev ); Log_MirrorInit( Ev );
+	...
+	Log_MirrorSeal( Ev, rec ); Log_NoblockingWrite( Ev, rec );
+	...
+	if ( Log_NoblockingWrite( Ev, 0 ) ) Log_MirrorStep( Ev );
+
+*/
+
+
+#ifndef EE_LOGS_MIRROR_H
+#define EE_LOGS_MIRROR_H
+
+#ifndef LOG_MIRROR_WRITE
+#define LOG_MIRROR_READ( a )		ReadEE( (void*)(a) )
+#define LOG_MIRROR_WRITE( a, b )	WriteEE( (void*)(a), (b) )
+#define LOG_MIRROR_FREE()		isEEfree()
+#if defined( LOG_PAGE_SIZE ) && !defined( LOG_MIRROR_PAGE )
+#define LOG_MIRROR_PAGE( a, p, n )	WriteEEPage( (void*)(a), (p), (n) )
+#endif
+#endif
+
+#ifdef LOG_MIRROR_PAGE
+#define Log_MirrorChunk( a, p, n )	LOG_MIRROR_PAGE( a, p, n )
+#define Log_MirrorRoom( a, rem )	Log_PageRoom( a, rem )
+#else
+#define Log_MirrorChunk( a, p, n )	LOG_MIRROR_WRITE( a, *(p) )
+#define Log_MirrorRoom( a, rem )	((unsigned char)1)
+#endif
+
+enum { LOG_MIRROR_BAD = 1, LOG_MIRROR_MAIN, LOG_MIRROR_COPY };
+
+/* CRC7 (x^7 + x^3 + 1) of n bytes from p */
+static inline unsigned char
+Log_Crc7( const unsigned char * p, unsigned char n )
+{
+	unsigned char c = 0, b, i;
+	while ( n-- )
+	{
+		b = *p++;
+		for ( i = 0; i < 8; ++i, b <<= 1 )
+		{
+			c <<= 1;
+			if ( (b ^ c) & 0x80 ) c ^= 0x09;
+		}
+	}
+	return c & 0x7F;
+}
+
+/* CRC7 of record rec of size n is right */
+#define Log_Crc7Ok( rec, n )						\
+	( Log_Crc7( rec, (n)-1 ) == ((rec)[(n)-1] & 0x7F) )
+
+#endif /* EE_LOGS_MIRROR_H */
+
+
+#define DECLARE_LOG_MIRROR( name )					\
+									\
+void Log_MirrorInit ## name ( void );					\
+unsigned char Log_MirrorStep ## name ( void );				\
+void Log_MirrorSeal ## name ( unsigned char * rec );			\
+unsigned char Log_MirrorFirst ## name ( unsigned char * dst );		\
+unsigned char Log_MirrorLast ## name ( unsigned char * dst );		\
+unsigned char Log_MirrorNext ## name ( unsigned char * dst );		\
+unsigned char Log_MirrorPrev ## name ( unsigned char * dst );
+
+
+#define Log_MirrorInit( name )		Log_MirrorInit ## name ()
+#define Log_MirrorStep( name )		Log_MirrorStep ## name ()
+#define Log_MirrorSeal( name, rec )	Log_MirrorSeal ## name ( rec )
+#define Log_MirrorFirst( name, dst )	Log_MirrorFirst ## name ( dst )
+#define Log_MirrorLast( name, dst )	Log_MirrorLast ## name ( dst )
+#define Log_MirrorNext( name, dst )	Log_MirrorNext ## name ( dst )
+#define Log_MirrorPrev( name, dst )	Log_MirrorPrev ## name ( dst )
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_MIRROR( name, recs, rec_size, mirror_addr )			\
+									\
+/* error here: MIRROR_ADDR is not aligned to slot (see LOG_PAGE_ALIGN) */\
+typedef char Log_MirrorAligned__ ## name				\
+	[ Log_SlotAligned( rec_size, mirror_addr ) ? 1 : -1 ];		\
+									\
+static unsigned char Log_MirrorBuf__ ## name [rec_size];		\
+static unsigned char Log_MirrorRec__ ## name;	/* not copied */	\
+static unsigned char Log_MirrorLap__ ## name;	/* flag of its pass */	\
+static unsigned char Log_MirrorCnt__ ## name;	/* copied before it */	\
+static unsigned char Log_MirrorPos__ ## name;	/* written bytes */	\
+									\
+/* flag of record r of log */						\
+static unsigned char							\
+Log_MirrorFlag__ ## name ( unsigned char r )				\
+{									\
+	return ( r < Log_State__ ## name .rec ) ? Log_CurFlag( name )	\
+		: (unsigned char)( Log_CurFlag( name ) ^ LOG_FLAG_MASK );\
+}									\
+									\
+/* log passed the mirror (records of the mirror may be 2 passes old) */	\
+static unsigned char							\
+Log_MirrorPassed__ ## name ( void )					\
+{									\
+	return ( Log_MirrorLap__ ## name == Log_CurFlag( name ) )	\
+		!= ( Log_MirrorRec__ ## name <= Log_State__ ## name .rec );\
+}									\
+									\
+/* read record r of the mirror (with flag) */				\
+static void								\
+Log_MirrorRead__ ## name ( unsigned char * rec, unsigned char r )	\
+{									\
+	unsigned int a = Log_RecAddr( mirror_addr, rec_size, r );	\
+	unsigned char i = 0;						\
+	Log_BusWait();							\
+	do {								\
+		rec[i] = LOG_MIRROR_READ( a + i );			\
+		Log_BusYield( i + 1 );					\
+	} while ( ++i < (rec_size) );					\
+	Log_BusRelease();						\
+}									\
+									\
+/* record r of the mirror is a copy of rec of log (or rec is damaged) */\
+static unsigned char							\
+Log_MirrorCopied__ ## name ( const unsigned char * rec, unsigned char r )\
+{									\
+	unsigned char m[rec_size];					\
+	unsigned char i = 0;						\
+	Log_MirrorRead__ ## name ( m, r );				\
+	if ( (m[(rec_size)-1] & LOG_FLAG_MASK) != Log_MirrorFlag__ ## name ( r ) )\
+		return 0;						\
+	m[(rec_size)-1] &= (unsigned char)~LOG_FLAG_MASK;		\
+	while ( m[i] == rec[i] )					\
+		if ( ++i == (rec_size) ) return 1;			\
+	return !Log_Crc7Ok( rec, rec_size ) && Log_Crc7Ok( m, rec_size );\
+}									\
+									\
+void									\
+Log_MirrorInit ## name ( void )						\
+{									\
+	unsigned char r = Log_State__ ## name .rec;			\
+	unsigned char n = 0;						\
+	Log_IncRec( r, recs );						\
+	while ( r != Log_State__ ## name .rec )				\
+	{								\
+		Log_ReadRec__ ## name ( Log_MirrorBuf__ ## name, r );	\
+		if ( !Log_MirrorCopied__ ## name ( Log_MirrorBuf__ ## name, r ) )\
+			break;						\
+		Log_IncRec( r, recs );					\
+		++n;							\
+	}								\
+	Log_MirrorRec__ ## name = r;					\
+	Log_MirrorLap__ ## name = Log_MirrorFlag__ ## name ( r );	\
+	Log_MirrorCnt__ ## name = n;					\
+	Log_MirrorPos__ ## name = 0;					\
+}									\
+									\
+unsigned char								\
+Log_MirrorStep ## name ( void )						\
+{									\
+	unsigned char i = Log_MirrorPos__ ## name;			\
+	unsigned char r = Log_MirrorRec__ ## name;			\
+	unsigned int a = Log_RecAddr( mirror_addr, rec_size, r );	\
+	unsigned char n;						\
+	if ( !isEEfree() || !LOG_MIRROR_FREE() ) return 0;		\
+	if ( i == (rec_size) )						\
+	{ /* the last byte is written */				\
+		Log_IncRec( r, recs );					\
+		if ( !r ) Log_MirrorLap__ ## name ^= LOG_FLAG_MASK;	\
+		Log_MirrorRec__ ## name = r;				\
+		if ( Log_MirrorCnt__ ## name < (recs)-1 )		\
+			++ Log_MirrorCnt__ ## name;			\
+		Log_MirrorPos__ ## name = i = 0;			\
+	}								\
+	if ( !i )							\
+	{								\
+		if ( Log_MirrorPassed__ ## name () )			\
+		{ /* copy from the first record of log */		\
+			r = Log_State__ ## name .rec;			\
+			Log_IncRec( r, recs );				\
+			Log_MirrorRec__ ## name = r;			\
+			Log_MirrorLap__ ## name = Log_MirrorFlag__ ## name ( r );\
+			Log_MirrorCnt__ ## name = 0;			\
+		}							\
+		if ( r == Log_State__ ## name .rec ) return 1;		\
+		Log_ReadRec__ ## name ( Log_MirrorBuf__ ## name, r );	\
+		Log_MirrorBuf__ ## name [(rec_size)-1] |=		\
+			Log_MirrorFlag__ ## name ( r );			\
+		a = Log_RecAddr( mirror_addr, rec_size, r );		\
+	}								\
+	if ( !Log_BusAcquire() ) return 0;				\
+	if ( i == (rec_size)-1 )					\
+	{								\
+		LOG_MIRROR_WRITE( a + i, Log_MirrorBuf__ ## name [i] );	\
+		++i;							\
+	} else {							\
+		n = Log_MirrorRoom( a + i, (rec_size)-1 - i );		\
+		Log_MirrorChunk( a + i, Log_MirrorBuf__ ## name + i, n );\
+		i += n;							\
+	}								\
+	Log_BusRelease();						\
+	Log_MirrorPos__ ## name = i;					\
+	return 0;							\
+}									\
+									\
+void									\
+Log_MirrorSeal ## name ( unsigned char * rec )				\
+{									\
+	rec[(rec_size)-1] = ( rec[(rec_size)-1] & LOG_FLAG_MASK )	\
+		| Log_Crc7( rec, (rec_size)-1 );			\
+}									\
+									\
+/* check the 'current record' in dst, read it from the mirror */	\
+static unsigned char							\
+Log_MirrorCheck__ ## name ( unsigned char * dst )			\
+{									\
+	unsigned char rec[rec_size];					\
+	unsigned char r = Log_State__ ## name .read;			\
+	unsigned char i = Log_MirrorRec__ ## name - r;			\
+	if ( Log_Crc7Ok( dst, rec_size ) ) return LOG_MIRROR_MAIN;	\
+	if ( Log_MirrorRec__ ## name < r ) i += (recs);			\
+	if ( !i || i > Log_MirrorCnt__ ## name				\
+		|| Log_MirrorPassed__ ## name () )			\
+		return LOG_MIRROR_BAD;	/* it is not copied */		\
+	Log_MirrorRead__ ## name ( rec, r );				\
+	if ( (rec[(rec_size)-1] & LOG_FLAG_MASK)			\
+			!= Log_MirrorFlag__ ## name ( r )		\
+		|| !Log_Crc7Ok( rec, rec_size ) )			\
+		return LOG_MIRROR_BAD;					\
+	rec[(rec_size)-1] &= (unsigned char)~LOG_FLAG_MASK;		\
+	i = 0;								\
+	do dst[i] = rec[i]; while ( ++i < (rec_size) );			\
+	return LOG_MIRROR_COPY;						\
+}									\
+									\
+unsigned char								\
+Log_MirrorFirst ## name ( unsigned char * dst )				\
+{									\
+	Log_ReadFirst ## name ( dst );					\
+	return Log_MirrorCheck__ ## name ( dst );			\
+}									\
+									\
+unsigned char								\
+Log_MirrorLast ## name ( unsigned char * dst )				\
+{									\
+	Log_ReadLast ## name ( dst );					\
+	return Log_MirrorCheck__ ## name ( dst );			\
+}									\
+									\
+unsigned char								\
+Log_MirrorNext ## name ( unsigned char * dst )				\
+{									\
+	if ( !Log_ReadNext ## name ( dst ) ) return 0;			\
+	return Log_MirrorCheck__ ## name ( dst );			\
+}									\
+									\
+unsigned char								\
+Log_MirrorPrev ## name ( unsigned char * dst )				\
+{									\
+	if ( !Log_ReadPrev ## name ( dst ) ) return 0;			\
+	return Log_MirrorCheck__ ## name ( dst );			\
+}
+
+
+/* End of file  ee-logs-mirror.h */
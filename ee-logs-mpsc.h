@@ -0,0 +1,257 @@
+/* ee-logs-mpsc.h */
+/*
+ Ring of pending records of many producers (interrupts) for In EEPROM
+ logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Log_NoblockingWrite and Log_Append are not reentrant, so they
+	are not called from interrupts.  Interrupts (producers) put
+	records to a ring of QLEN slots, one task (consumer, the main
+	loop) takes records from the ring and writes them to log.
+
+	A producer reserves the next free slot (the only shared
+	read-modify-write: tail of ring is incremented by atomic
+	compare and swap or in LOG_CRITICAL_BEGIN/END), fills it without
+	locks and commits it by the ready byte of the slot.  Slots are
+	taken by the consumer in order of reservation; the consumer
+	waits for a reserved slot which is not committed yet (a
+	producer interrupted by other producer commits it later).  The
+	consumer frees a slot by the store of head of ring, so it never
+	locks producers.  If the ring is full, the record is lost (it is
+	counted in Log_MpscLost).
+
+	Head and tail are free-running bytes, QLEN is a power of 2 not
+	greater than 128.
+
+
+ Used extern functions:
+
+	as ee-logs.h
+
+
+ Configuration macros (define it before include this file):
+
+ LOG_CRITICAL_BEGIN(), LOG_CRITICAL_END()
+	begin and end of a short section which is not interrupted by
+	other producers (for example, save the state of interrupts and
+	disable them; restore the state); if they are not defined,
+	atomic builtins of GCC (__atomic_compare_exchange_n and others)
+	are used instead of the section (for hosts and cores with
+	atomic instructions, for cores without them define the macros)
+
+	Loads and stores of ready bytes and of head and tail are done
+	by __atomic_load_n and __atomic_store_n (acquire and release;
+	ordinary loads and stores of a byte on 8-bit cores).
+
+
+ Define these macros and functions:
+
+ DECLARE_LOG_MPSC( NAME )
+	declare the ring of log NAME
+
+ LOG_MPSC( NAME, REC_SIZE, QLEN )
+	define the ring of QLEN records of log NAME (log must be
+	defined by LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it
+	in the same file)
+
+ Log_MpscReserve( NAME )
+	(producer) reserve a slot; return address of it (REC_SIZE bytes
+	to fill) or 0 if the ring is full
+
+ Log_MpscCommit( NAME, void * SLOT )
+	(producer) the reserved slot is filled
+
+ Log_MpscPush( NAME, const void * SRC )
+	(producer) reserve a slot, copy record SRC to it and commit it;
+	return 0 if the ring is full
+
+ Log_MpscPeek( NAME )
+	(consumer) return address of the oldest committed record or 0
+	(the ring is empty or the oldest slot is not committed yet)
+
+ Log_MpscPop( NAME )
+	(consumer) free the slot returned by Log_MpscPeek
+
+ Log_MpscDrain( NAME )
+	(consumer) no blocking write records of the ring to log by
+	Log_NoblockingWrite; call it periodical;
+	return not 0 if the ring is empty and all writing is terminated
+
+ Log_MpscLost( NAME )
+	number of records lost because the ring is full (unsigned int)
+
+
+ Example (AVR):
+
+	#define LOG_CRITICAL_BEGIN()					\
+		{ unsigned char sreg__ = SREG; cli();
+	#define LOG_CRITICAL_END()	SREG = sreg__; }
+	#include "ee-logs.h"
+	#include "ee-logs-mpsc.h"
+
+	DECLARE_LOGGER( Ev, 100, 4, 0 )
+	DECLARE_LOG_MPSC( Ev )
+	LOGGER( Ev, 100, 4, 0 )
+	LOG_MPSC( Ev, 4, 16 )
+
+	ISR( INT0_vect ) { ...; Log_MpscPush( Ev, rec ); }
+
+	for (;;) { Log_MpscDrain( Ev ); ... }
+
+	Log_MpscPeek and Log_MpscPop give records to Log_Append of
+	queue (ee-logs.h) or to other consumer instead of
+	Log_MpscDrain.
+
+*/
+
+
+#ifndef EE_LOGS_MPSC_H
+#define EE_LOGS_MPSC_H
+
+#define Log_MpscLoad( p )	__atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define Log_MpscStore( p, v )	__atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+
+/* reserve slot of ring of qlen slots with tail *t and head *h;
+   return number of slot (free-running) or -1 if the ring is full
+   (and count it in *lost) */
+static inline int
+Log_MpscClaim( unsigned char * t, unsigned char * h, unsigned char qlen,
+		unsigned int * lost )
+{
+	unsigned char s;
+#ifdef LOG_CRITICAL_BEGIN
+	int r = -1;
+	LOG_CRITICAL_BEGIN();
+	s = *t;
+	if ( (unsigned char)( s - Log_MpscLoad( h ) ) == qlen ) ++ *lost;
+	else
+	{
+		Log_MpscStore( t, (unsigned char)( s + 1 ) );
+		r = s;
+	}
+	LOG_CRITICAL_END();
+	return r;
+#else
+	s = __atomic_load_n( t, __ATOMIC_RELAXED );
+	do {
+		if ( (unsigned char)( s - Log_MpscLoad( h ) ) == qlen )
+		{
+			__atomic_fetch_add( lost, 1, __ATOMIC_RELAXED );
+			return -1;
+		}
+	} while ( !__atomic_compare_exchange_n( t, &s, (unsigned char)( s + 1 ),
+			1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) );
+	return s;
+#endif
+}
+
+#endif /* EE_LOGS_MPSC_H */
+
+
+#define DECLARE_LOG_MPSC( name )					\
+									\
+unsigned char * Log_MpscReserve ## name ( void );			\
+void Log_MpscCommit ## name ( unsigned char * slot );			\
+unsigned char Log_MpscPush ## name ( const unsigned char * src );	\
+unsigned char * Log_MpscPeek ## name ( void );				\
+void Log_MpscPop ## name ( void );					\
+unsigned char Log_MpscDrain ## name ( void );				\
+extern unsigned int Log_MpscLost__ ## name;
+
+
+#define Log_MpscReserve( name )		Log_MpscReserve ## name ()
+#define Log_MpscCommit( name, slot )	Log_MpscCommit ## name ( slot )
+#define Log_MpscPush( name, src )	Log_MpscPush ## name ( src )
+#define Log_MpscPeek( name )		Log_MpscPeek ## name ()
+#define Log_MpscPop( name )		Log_MpscPop ## name ()
+#define Log_MpscDrain( name )		Log_MpscDrain ## name ()
+#define Log_MpscLost( name )		Log_MpscLost__ ## name
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_MPSC( name, rec_size, qlen )				\
+									\
+typedef char Log_MpscFits__ ## name					\
+	[ ((qlen) >= 1 && (qlen) <= 128 && Log_IsPow2( qlen )) ? 1 : -1 ];\
+									\
+/* records and ready bytes (after records) */				\
+static unsigned char Log_Mpsc__ ## name [qlen][(rec_size) + 1];		\
+static unsigned char Log_MpscHead__ ## name;				\
+static unsigned char Log_MpscTail__ ## name;				\
+unsigned int Log_MpscLost__ ## name;					\
+									\
+unsigned char *								\
+Log_MpscReserve ## name ( void )					\
+{									\
+	int s = Log_MpscClaim( & Log_MpscTail__ ## name,		\
+			& Log_MpscHead__ ## name, (qlen),		\
+			& Log_MpscLost__ ## name );			\
+	return ( s < 0 ) ? 0 : Log_Mpsc__ ## name [s & ((qlen)-1)];	\
+}									\
+									\
+void									\
+Log_MpscCommit ## name ( unsigned char * slot )				\
+{									\
+	Log_MpscStore( slot + (rec_size), 1 );				\
+}									\
+									\
+unsigned char								\
+Log_MpscPush ## name ( const unsigned char * src )			\
+{									\
+	unsigned char * p = Log_MpscReserve ## name ();			\
+	unsigned char i = 0;						\
+	if ( !p ) return 0;						\
+	do p[i] = src[i]; while ( ++i < (rec_size) );			\
+	Log_MpscStore( p + (rec_size), 1 );				\
+	return 1;							\
+}									\
+									\
+unsigned char *								\
+Log_MpscPeek ## name ( void )						\
+{									\
+	unsigned char * p = Log_Mpsc__ ## name				\
+		[Log_MpscHead__ ## name & ((qlen)-1)];			\
+	return Log_MpscLoad( p + (rec_size) ) ? p : 0;			\
+}									\
+									\
+void									\
+Log_MpscPop ## name ( void )						\
+{									\
+	unsigned char h = Log_MpscHead__ ## name;			\
+	Log_Mpsc__ ## name [h & ((qlen)-1)][rec_size] = 0;		\
+	Log_MpscStore( & Log_MpscHead__ ## name, (unsigned char)( h + 1 ) );\
+}									\
+									\
+unsigned char								\
+Log_MpscDrain ## name ( void )						\
+{									\
+	unsigned char * p = Log_MpscPeek ## name ();			\
+	if ( !p ) return Log_NoblockingWrite ## name ( 0 )		\
+		&& !Log_MpscPeek ## name ()				\
+		&& Log_MpscLoad( & Log_MpscTail__ ## name )		\
+			== Log_MpscHead__ ## name;			\
+	if ( !Log_NoblockingWrite ## name ( p ) ) return 0;		\
+	Log_MpscPop ## name ();						\
+	return 0;							\
+}
+
+
+/* End of file  ee-logs-mpsc.h */
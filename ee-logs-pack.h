@@ -0,0 +1,139 @@
+/* ee-logs-pack.h */
+/*
+ Bit-packed records for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Fields of record are packed at bit granularity.  Schema of
+	record is a list of fields with width in bits (1..16):
+
+	#define TELEMETRY( F, r )					\
+		F( r, adc,    10 )					\
+		F( r, alarm,   1 )					\
+		F( r, event,   5 )					\
+		F( r, dt,     12 )
+
+	LOG_RECORD( Tm, TELEMETRY )
+
+	Field K is placed after field K-1 (from bit 0 of byte 0 of
+	record, bit 0 of a byte is the first).  Bit 7 of the last
+	byte of record (LOG_FLAG_MASK) is never used: Log_Pack clears
+	it (the logger writes the flag there), Log_Unpack ignores it.
+	Offset of every field is known at compile time, so pack/unpack
+	functions are straight code without loops and branches (with
+	optimization).
+
+
+ Define these macros and functions:
+
+ LOG_RECORD( R, SCHEMA )
+	define record R with fields from SCHEMA:
+	struct Log_Rec_R -- unpacked record (field F is unsigned int);
+	Log_RecSize_R -- size of packed record (use it as REC_SIZE
+	of log), it is the least size with one spare bit for flag
+	and not less than 2 bytes (as ee-logs.h requires)
+
+ Log_Pack( R, void * DST, struct Log_Rec_R * SRC )
+	pack record from SRC to DST (Log_RecSize_R bytes)
+
+ Log_Unpack( R, struct Log_Rec_R * DST, void * SRC )
+	unpack record from SRC (Log_RecSize_R bytes) to DST
+
+	ee-logs.h must be included before this file.
+
+*/
+
+
+#ifndef EE_LOGS_PACK_H
+#define EE_LOGS_PACK_H
+
+#include <stddef.h>
+
+
+/* put w bits of v from bit pos of p (p must have zero in these bits) */
+static inline void
+Log_PutBits( unsigned char * p, unsigned int pos, unsigned char w,
+		unsigned long v )
+{
+	p += pos >> 3;
+	v = ( v & ((1UL << w) - 1) ) << (pos & 7);
+	p[0] |= (unsigned char) v;
+	if ( (pos & 7) + w > 8 ) p[1] |= (unsigned char)(v >> 8);
+	if ( (pos & 7) + w > 16 ) p[2] |= (unsigned char)(v >> 16);
+}
+
+/* get w bits from bit pos of p */
+static inline unsigned int
+Log_GetBits( const unsigned char * p, unsigned int pos, unsigned char w )
+{
+	unsigned long v;
+	p += pos >> 3;
+	v = p[0];
+	if ( (pos & 7) + w > 8 ) v |= (unsigned long) p[1] << 8;
+	if ( (pos & 7) + w > 16 ) v |= (unsigned long) p[2] << 16;
+	return (unsigned int)( (v >> (pos & 7)) & ((1UL << w) - 1) );
+}
+
+#endif /* EE_LOGS_PACK_H */
+
+
+#define Log_RecField__( r, f, w )	unsigned int f;
+#define Log_RecBits__( r, f, w )	char f[w];
+#define Log_RecWidth__( r, f, w )	char f[((w) >= 1 && (w) <= 16) ? 1 : -1];
+#define Log_RecPack__( r, f, w )					\
+	Log_PutBits( dst, offsetof( struct Log_Bits_ ## r, f ), (w), src->f );
+#define Log_RecUnpack__( r, f, w )					\
+	dst->f = Log_GetBits( src, offsetof( struct Log_Bits_ ## r, f ), (w) );
+
+
+#define LOG_RECORD( r, schema )						\
+									\
+struct Log_Rec_ ## r { schema( Log_RecField__, r ) };			\
+									\
+/* byte K of this struct is bit K of packed record */			\
+struct Log_Bits_ ## r { schema( Log_RecBits__, r ) };			\
+struct Log_Width_ ## r { schema( Log_RecWidth__, r ) };			\
+									\
+/* 2 bytes at least: the logger writes REC_SIZE-1 bytes before flag */	\
+enum { Log_RecSize_ ## r = ( sizeof( struct Log_Bits_ ## r ) < 8 ) ? 2	\
+	: (sizeof( struct Log_Bits_ ## r ) + 8) / 8 };			\
+									\
+typedef char Log_RecFits_ ## r						\
+	[(Log_RecSize_ ## r >= 2 && Log_RecSize_ ## r <= 255) ? 1 : -1];\
+									\
+static inline void							\
+Log_Pack ## r ( unsigned char * dst, const struct Log_Rec_ ## r * src )	\
+{									\
+	unsigned char i;						\
+	for ( i = 0; i < Log_RecSize_ ## r; ++i ) dst[i] = 0;		\
+	schema( Log_RecPack__, r )					\
+}									\
+									\
+static inline void							\
+Log_Unpack ## r ( struct Log_Rec_ ## r * dst, const unsigned char * src )\
+{									\
+	schema( Log_RecUnpack__, r )					\
+}
+
+
+#define Log_Pack( r, dst, src )		Log_Pack ## r ( dst, src )
+#define Log_Unpack( r, dst, src )	Log_Unpack ## r ( dst, src )
+
+
+/* End of file  ee-logs-pack.h */
@@ -0,0 +1,267 @@
+/* ee-logs-scrub.h */
+/*
+ Background scrubber (refresh of weak records) for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Cells of EEPROM lose charge with time (faster if it is hot), so
+	records which are not rewritten for a long time get wrong bits.
+	Log_ScrubStep reads slots of ring one by one (LOG_SCRUB_BYTES
+	bytes by a call) and checks every record by LOG_SCRUB_CHECK
+	(ECC of ee-logs-ecc.h by default); if a wrong bit is corrected,
+	bytes of the record which differ from the corrected record are
+	written again (one byte by a call, every byte at most once), so
+	the record is refreshed before the second bit is lost.  Records
+	which can not be corrected are counted only.
+
+	The last byte of record has the flag which Log_Init uses to
+	find the free slot, so it is written again only if the flag
+	bit of the corrected byte is the flag of the pass of the slot
+	(the record is counted as bad else).  A power loss while this
+	byte is written may leave any value in it: if its flag bit
+	becomes wrong, Log_Init takes the slot as the free slot and the
+	newer records as the oldest ones.  Other bytes are written
+	before it, so a record is refreshed by one write of the last
+	byte at most.
+
+	Slots are walked from 0 to RECS-1 (a pass), the free slot of
+	log is skipped; a record which is overwritten by log while it is
+	checked or refreshed is skipped.  Not more than LOG_SCRUB_WRITES
+	records are refreshed in a pass (against wear when many cells
+	are weak), other corrected records are left for next passes.
+
+	Log_ScrubStep works only if EEPROM is free (call it when EEPROM
+	is not used by writers, for example, after
+	Log_NoblockingWrite( NAME, 0 ) or Log_Flush returns not 0).
+	Progress and results are in struct Log_ScrubStat of the log.
+
+
+ Used extern functions:
+
+	as ee-logs.h
+
+
+ Configuration macros (define it before include this file):
+
+ LOG_SCRUB_BYTES
+	bytes read by one call of Log_ScrubStep (default 4)
+
+ LOG_SCRUB_WRITES
+	records refreshed in a pass at most (default 4)
+
+ LOG_SCRUB_CHECK( REC, REC_SIZE )
+	check and correct record REC (with flag bit); return
+	LOG_ECC_OK, LOG_ECC_FIXED or LOG_ECC_BAD (default: Log_EccCheck
+	of ee-logs-ecc.h, which must be included before this file)
+
+
+ Define these macros and functions:
+
+ struct Log_ScrubStat
+	passes	-- number of ended passes
+	slot	-- slot which is checked now (progress of the pass)
+	checked	-- records checked
+	fixed	-- records refreshed
+	writes	-- bytes written
+	deferred -- corrected records left for next passes
+	bad	-- records which can not be corrected (slots of a new
+		   log which are never written and records with wrong
+		   flag are counted here too)
+
+ DECLARE_LOG_SCRUB( NAME )
+	declare scrubber of log NAME
+
+ LOG_SCRUB( NAME, RECS, REC_SIZE, START_ADDR )
+	define scrubber of log NAME (log must be defined by
+	LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it in the
+	same file)
+
+ Log_ScrubStep( NAME )
+	no blocking check (and refresh) records of log NAME;
+	return not 0 if a pass is ended by this call
+
+ Log_ScrubStat( NAME )
+	struct Log_ScrubStat of log NAME (user may clear its counters,
+	but not slot)
+
+
+ Example:
+
+	#include "ee-logs.h"
+	#include "ee-logs-ecc.h"
+	#include "ee-logs-scrub.h"
+
+	DECLARE_LOGGER( Ev, 100, 8, 0 )
+	DECLARE_LOG_SCRUB( Ev )
+	LOGGER( Ev, 100, 8, 0 )
+	LOG_ECC( Ev, 8 )
+	LOG_SCRUB( Ev, 100, 8, 0 )
+
+	if ( Log_NoblockingWrite( Ev, 0 ) ) Log_ScrubStep( Ev );
+	...
+	report( Log_ScrubStat( Ev ).fixed, Log_ScrubStat( Ev ).bad );
+
+*/
+
+
+#ifndef EE_LOGS_SCRUB_H
+#define EE_LOGS_SCRUB_H
+
+#ifndef LOG_SCRUB_BYTES
+#define LOG_SCRUB_BYTES		4
+#endif
+
+#ifndef LOG_SCRUB_WRITES
+#define LOG_SCRUB_WRITES	4
+#endif
+
+#ifndef LOG_SCRUB_CHECK
+#define LOG_SCRUB_CHECK( rec, rec_size )	Log_EccCheck( rec, rec_size )
+#endif
+
+struct Log_ScrubStat {
+	unsigned int passes;
+	unsigned char slot;
+	unsigned int checked;
+	unsigned int fixed;
+	unsigned int writes;
+	unsigned int deferred;
+	unsigned int bad;
+};
+
+#endif /* EE_LOGS_SCRUB_H */
+
+
+#define DECLARE_LOG_SCRUB( name )					\
+									\
+extern struct Log_ScrubStat Log_ScrubStat__ ## name;			\
+unsigned char Log_ScrubStep ## name ( void );
+
+
+#define Log_ScrubStep( name )		Log_ScrubStep ## name ()
+#define Log_ScrubStat( name )		Log_ScrubStat__ ## name
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_SCRUB( name, recs, rec_size, start_addr )			\
+									\
+struct Log_ScrubStat Log_ScrubStat__ ## name;				\
+									\
+static unsigned char Log_ScrubBuf__ ## name [rec_size];			\
+static unsigned char Log_ScrubPos__ ## name;	/* read bytes */	\
+static unsigned char Log_ScrubFix__ ## name;	/* 1 + byte to refresh */\
+static unsigned char Log_ScrubCur__ ## name;	/* free slot at start */\
+static unsigned char Log_ScrubUsed__ ## name;	/* refreshed in pass */	\
+									\
+/* slot r is written by log after start of its checking */		\
+static unsigned char							\
+Log_ScrubOver__ ## name ( unsigned char r )				\
+{									\
+	unsigned char c = Log_ScrubCur__ ## name;			\
+	unsigned int d = ( r < c ) ? r + (recs) - c : r - c;		\
+	return d <= ( ( Log_State__ ## name .rec < c )			\
+		? (unsigned int)( Log_State__ ## name .rec + (recs) - c )\
+		: (unsigned int)( Log_State__ ## name .rec - c ) );	\
+}									\
+									\
+/* flag of record in slot r (it is not the free slot) */		\
+static unsigned char							\
+Log_ScrubFlag__ ## name ( unsigned char r )				\
+{									\
+	unsigned char f = Log_CurFlag( name );				\
+	return ( r < Log_State__ ## name .rec ) ? f : f ^ LOG_FLAG_MASK;\
+}									\
+									\
+unsigned char								\
+Log_ScrubStep ## name ( void )						\
+{									\
+	struct Log_ScrubStat * s = & Log_ScrubStat__ ## name;		\
+	unsigned char * b = Log_ScrubBuf__ ## name;			\
+	unsigned char r = s->slot;					\
+	unsigned char i = Log_ScrubPos__ ## name;			\
+	unsigned char n = (LOG_SCRUB_BYTES);				\
+	unsigned char ret = 0;						\
+	unsigned int a = Log_RecAddr( start_addr, rec_size, r );	\
+	if ( !isEEfree() ) return 0;					\
+	if ( !Log_BusAcquire() ) return 0;				\
+	if ( Log_ScrubFix__ ## name )					\
+	{ /* refresh bytes of corrected record */			\
+		if ( Log_ScrubOver__ ## name ( r ) ) goto next;		\
+		for ( i = Log_ScrubFix__ ## name - 1; i < (rec_size); ++i )\
+		{							\
+			if ( ReadEE( (void*)( a + i ) ) == b[i] ) continue;\
+			if ( i == (rec_size)-1 && (b[i] & LOG_FLAG_MASK)\
+				!= Log_ScrubFlag__ ## name ( r ) )	\
+			{ /* it would move the free slot */		\
+				++ s->bad;				\
+				goto next;				\
+			}						\
+			WriteEE( (void*)( a + i ), b[i] );		\
+			++ s->writes;					\
+			Log_ScrubFix__ ## name = i + 2;			\
+			goto done;					\
+		}							\
+		++ s->fixed;						\
+		goto next;						\
+	}								\
+	if ( !i )							\
+	{ /* start checking of slot r */				\
+		if ( r == Log_State__ ## name .rec ) goto next;		\
+		Log_ScrubCur__ ## name = Log_State__ ## name .rec;	\
+	}								\
+	do b[i] = ReadEE( (void*)( a + i ) );				\
+	while ( ++i < (rec_size) && --n );				\
+	if ( i < (rec_size) ) goto done;				\
+	if ( Log_ScrubOver__ ## name ( r ) ) goto next;			\
+	++ s->checked;							\
+	switch ( LOG_SCRUB_CHECK( b, rec_size ) )			\
+	{								\
+	case LOG_ECC_FIXED:						\
+		if ( Log_ScrubUsed__ ## name < (LOG_SCRUB_WRITES) )	\
+		{							\
+			++ Log_ScrubUsed__ ## name;			\
+			Log_ScrubFix__ ## name = 1;			\
+			goto done;					\
+		}							\
+		++ s->deferred;						\
+		break;							\
+	case LOG_ECC_BAD:						\
+		++ s->bad;						\
+		break;							\
+	}								\
+next:	/* go to the next slot */					\
+	i = 0;								\
+	Log_ScrubFix__ ## name = 0;					\
+	Log_IncRec( r, recs );						\
+	if ( !r )							\
+	{ /* the pass is ended */					\
+		++ s->passes;						\
+		Log_ScrubUsed__ ## name = 0;				\
+		ret = 1;						\
+	}								\
+done:									\
+	s->slot = r;							\
+	Log_ScrubPos__ ## name = i;					\
+	Log_BusRelease();						\
+	return ret;							\
+}
+
+
+/* End of file  ee-logs-scrub.h */
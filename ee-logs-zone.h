@@ -0,0 +1,256 @@
+/* ee-logs-zone.h */
+/*
+ Zone maps (min and max of key of blocks of records) for In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Key of record is little endian unsigned number of WIDTH bytes
+	(1..4) from byte OFFSET of record (timestamp, code of event and
+	so on; flag bit is cleared as Log_Read* functions do).
+
+	Slots of ring are divided into blocks of BLOCK slots (block K
+	is slots K*BLOCK .. K*BLOCK+BLOCK-1).  Zone map keeps in RAM
+	min and max of keys of every block, so range queries read only
+	records of blocks which range overlaps the range of query.
+
+	Zone map is built by Log_ZoneBuild (reads all records) and is
+	updated by Log_ZoneNote for every written record (it must be
+	called from LOG_WRITE_HOOK of ee-logs.h).  A written record
+	widens range of its block; when all slots of block are
+	rewritten, the range of block is replaced by range of new
+	records only.  So range of block always covers keys of its
+	records (may be wider).
+
+	RAM: 2 * sizeof( LOG_ZONE_KEY ) bytes for every block and
+	for the block being rewritten.
+
+
+ Configuration macros (define it before include this file):
+
+ LOG_ZONE_KEY
+	type of keys (default: unsigned long); unsigned char or
+	unsigned int save RAM for keys of 1 or 2 bytes
+
+
+ Define these macros and functions:
+
+ DECLARE_LOG_ZONE( NAME )
+	declare zone map of log NAME
+
+ LOG_ZONE( NAME, RECS, REC_SIZE, OFFSET, WIDTH, BLOCK )
+	define zone map of log NAME (log must be defined by
+	LOGGER( NAME, RECS, REC_SIZE, START_ADDR ) before it in the
+	same file), 1 <= BLOCK <= RECS
+
+ Log_ZoneBuild( NAME )
+	build zone map of log NAME (call it after Log_Init)
+
+ Log_ZoneNote( NAME, unsigned char SLOT, void * REC )
+	record REC is written to slot SLOT of ring (the arguments of
+	LOG_WRITE_HOOK)
+
+ Log_ZoneFirst( NAME, LO, HI, void * DST )
+	read the first (the oldest) record of log NAME with key from
+	LO to HI to address DST;
+	return 0 if there is no such record, else return not 0
+	and the read record become the 'current record'
+
+ Log_ZoneNext( NAME, LO, HI, void * DST )
+	read the next record after the 'current record' with key
+	from LO to HI (as Log_ZoneFirst)
+
+
+ Example (queue or Log_NoblockingWrite writes records):
+
+	#define LOG_WRITE_HOOK( name, slot, rec )			\
+		Log_ZoneNote ## name ( slot, rec )
+	#include "ee-logs.h"
+	#include "ee-logs-zone.h"
+
+	DECLARE_LOGGER( Ev, 100, 8, 0 )
+	DECLARE_LOG_ZONE( Ev )
+	LOGGER( Ev, 100, 8, 0 )
+	LOG_ZONE( Ev, 100, 8, 0, 4, 16 )	-- timestamp in bytes 0..3
+
+*/
+
+
+#ifndef EE_LOGS_ZONE_H
+#define EE_LOGS_ZONE_H
+
+#ifndef LOG_ZONE_KEY
+#define LOG_ZONE_KEY	unsigned long
+#endif
+
+struct Log_Zone {
+	LOG_ZONE_KEY min, max;
+};
+
+/* key of record rec of size n */
+static inline LOG_ZONE_KEY
+Log_ZoneKey( const unsigned char * rec, unsigned char n,
+		unsigned char off, unsigned char width )
+{
+	LOG_ZONE_KEY k = 0;
+	unsigned char i = width;
+	do {
+		unsigned char b = rec[off + --i];
+		if ( off + i == n - 1 ) b &= (unsigned char)~LOG_FLAG_MASK;
+		k = (LOG_ZONE_KEY)( (k << 8) | b );
+	} while ( i );
+	return k;
+}
+
+static inline void
+Log_ZoneAdd( struct Log_Zone * z, LOG_ZONE_KEY k )
+{
+	if ( k < z->min ) z->min = k;
+	if ( k > z->max ) z->max = k;
+}
+
+#endif /* EE_LOGS_ZONE_H */
+
+
+#define DECLARE_LOG_ZONE( name )					\
+									\
+void Log_ZoneBuild ## name ( void );					\
+void Log_ZoneNote ## name ( unsigned char slot, const unsigned char * rec );\
+unsigned char Log_ZoneFirst ## name ( LOG_ZONE_KEY lo, LOG_ZONE_KEY hi,	\
+					unsigned char * dst );		\
+unsigned char Log_ZoneNext ## name ( LOG_ZONE_KEY lo, LOG_ZONE_KEY hi,	\
+					unsigned char * dst );
+
+
+#define Log_ZoneBuild( name )		Log_ZoneBuild ## name ()
+#define Log_ZoneNote( name, slot, rec )	Log_ZoneNote ## name ( slot, rec )
+#define Log_ZoneFirst( name, lo, hi, dst )				\
+					Log_ZoneFirst ## name ( lo, hi, dst )
+#define Log_ZoneNext( name, lo, hi, dst )				\
+					Log_ZoneNext ## name ( lo, hi, dst )
+
+
+/* ------------------------------------------------------------------- */
+
+#define LOG_ZONE( name, recs, rec_size, off, width, block )		\
+									\
+typedef char Log_ZoneFits__ ## name					\
+	[ ((width) >= 1 && (width) <= 4 && (off) + (width) <= (rec_size)\
+	  && (block) >= 1 && (block) <= (recs)) ? 1 : -1 ];		\
+									\
+static struct Log_Zone							\
+	Log_Zone__ ## name [((recs) + (block) - 1) / (block)];		\
+static struct Log_Zone Log_ZoneNew__ ## name;	/* rewritten block */	\
+static unsigned char Log_ZoneFill__ ## name;	/* slots of it */	\
+									\
+void									\
+Log_ZoneBuild ## name ( void )						\
+{									\
+	unsigned char rec[rec_size];					\
+	unsigned char r = 0;						\
+	LOG_ZONE_KEY k;							\
+	do {								\
+		Log_ReadRec__ ## name ( rec, r );			\
+		k = Log_ZoneKey( rec, (rec_size), (off), (width) );	\
+		if ( r % (block) == 0 )					\
+			Log_Zone__ ## name [r / (block)].min =		\
+			Log_Zone__ ## name [r / (block)].max = k;	\
+		else							\
+			Log_ZoneAdd( &Log_Zone__ ## name [r / (block)], k );\
+	} while ( ++r < (recs) );					\
+	Log_ZoneFill__ ## name = 0;					\
+}									\
+									\
+void									\
+Log_ZoneNote ## name ( unsigned char slot, const unsigned char * rec )	\
+{									\
+	LOG_ZONE_KEY k = Log_ZoneKey( rec, (rec_size), (off), (width) );\
+	struct Log_Zone * z = &Log_Zone__ ## name [slot / (block)];	\
+	Log_ZoneAdd( z, k );						\
+	if ( slot % (block) == 0 )					\
+	{ /* block is being rewritten */				\
+		Log_ZoneNew__ ## name .min = Log_ZoneNew__ ## name .max = k;\
+		Log_ZoneFill__ ## name = 1;				\
+	}								\
+	else if ( Log_ZoneFill__ ## name == slot % (block) )		\
+	{								\
+		Log_ZoneAdd( &Log_ZoneNew__ ## name, k );		\
+		++ Log_ZoneFill__ ## name;				\
+	}								\
+	else								\
+		Log_ZoneFill__ ## name = 0;	/* not from start */	\
+	if ( Log_ZoneFill__ ## name					\
+		&& (Log_ZoneFill__ ## name == (block) || slot == (recs)-1) )\
+	{ /* all slots of block are rewritten */			\
+		*z = Log_ZoneNew__ ## name;				\
+		Log_ZoneFill__ ## name = 0;				\
+	}								\
+}									\
+									\
+/* read the first record with key from lo to hi from slot r */		\
+static unsigned char							\
+Log_ZoneSeek__ ## name ( LOG_ZONE_KEY lo, LOG_ZONE_KEY hi,		\
+			unsigned char * dst, unsigned char r )		\
+{									\
+	const struct Log_Zone * z;					\
+	unsigned int e;							\
+	LOG_ZONE_KEY k;							\
+	while ( r != Log_State__ ## name .rec )				\
+	{								\
+		z = &Log_Zone__ ## name [r / (block)];			\
+		if ( z->max < lo || z->min > hi )			\
+		{ /* skip block (up to the 'free' record) */		\
+			e = ( r / (block) + 1 ) * (unsigned int)(block);\
+			if ( r < Log_State__ ## name .rec		\
+				&& Log_State__ ## name .rec < e )	\
+				return 0;				\
+			r = ( e >= (recs) ) ? 0 : (unsigned char) e;	\
+			continue;					\
+		}							\
+		Log_ReadRec__ ## name ( dst, r );			\
+		k = Log_ZoneKey( dst, (rec_size), (off), (width) );	\
+		if ( k >= lo && k <= hi )				\
+		{							\
+			Log_State__ ## name .read = r;			\
+			return 1;					\
+		}							\
+		Log_IncRec( r, recs );					\
+	}								\
+	return 0;							\
+}									\
+									\
+unsigned char								\
+Log_ZoneFirst ## name ( LOG_ZONE_KEY lo, LOG_ZONE_KEY hi,		\
+			unsigned char * dst )				\
+{									\
+	unsigned char r = Log_State__ ## name .rec;			\
+	Log_IncRec( r, recs );						\
+	return Log_ZoneSeek__ ## name ( lo, hi, dst, r );		\
+}									\
+									\
+unsigned char								\
+Log_ZoneNext ## name ( LOG_ZONE_KEY lo, LOG_ZONE_KEY hi,		\
+			unsigned char * dst )				\
+{									\
+	unsigned char r = Log_State__ ## name .read;			\
+	Log_IncRec( r, recs );						\
+	return Log_ZoneSeek__ ## name ( lo, hi, dst, r );		\
+}
+
+
+/* End of file  ee-logs-zone.h */
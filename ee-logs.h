@@ -44,6 +44,92 @@
 	write one byte BT to EEPROM at address ADDR
 	return immediate (not wait for finish writing)
 
+ void WriteEEPage( void * ADDR, const unsigned char * SRC, unsigned char N )
+	write N bytes from SRC to EEPROM at address ADDR (all N bytes
+	are in one page of EEPROM);
+	return immediate (not wait for finish writing);
+	used only if LOG_PAGE_SIZE is defined
+
+ void ReadEEBlock( void * ADDR, unsigned char * DST, unsigned char N )
+	read N bytes from EEPROM at address ADDR to DST by one
+	bus transaction;
+	used only if LOG_BURST_READ is defined
+
+ unsigned char LogBusAcquire( void )
+	return not 0, if the bus is granted to the logger;
+	return 0, if the bus is used by other client;
+	used only if LOG_BUS_ARBITER is defined
+
+ void LogBusRelease( void )
+	release the bus granted by LogBusAcquire;
+	used only if LOG_BUS_ARBITER is defined
+
+
+ Configuration macros (define it before include this file):
+
+ LOG_PAGE_SIZE
+	size of EEPROM page (power of 2, not greater than 256);
+	record (without its last byte) is written by page-bounded
+	chunks with WriteEEPage; the last byte of record (it holds
+	the flag) is always written alone with WriteEE after all
+	other bytes of record
+
+ LOG_PAGE_ALIGN
+	(only with LOG_PAGE_SIZE) record is placed in slot of
+	LOG_SLOT_SIZE( REC_SIZE ) bytes, so it never crosses bound
+	of page: a slot is the smallest power of 2 not less than
+	REC_SIZE (if REC_SIZE <= LOG_PAGE_SIZE), else REC_SIZE rounded
+	up to LOG_PAGE_SIZE; START_ADDR must be a multiple of the slot
+	(of the page for large slots), else LOGGER fails to compile;
+	Log_Flush writes one record by one transaction if slot is
+	greater than REC_SIZE
+
+ LOG_BURST_READ
+	records are read by chunks with ReadEEBlock
+
+ LOG_BUS_ARBITER
+	EEPROM is on a bus shared with other clients (sensors and so on);
+	every EEPROM transaction of loggers is made between LogBusAcquire
+	and LogBusRelease;
+	Log_NoblockingWrite returns 0 while the bus is not granted
+	(as if EEPROM is busy); readers wait for the bus
+
+ LOG_BUS_CHUNK
+	max number of bytes read by one bus grant
+	(default: 16 if LOG_BUS_ARBITER is defined, else 255)
+
+ LOG_WRITE_HOOK( NAME, SLOT, REC )
+	is called by Log_NoblockingWrite and Log_Flush of log NAME
+	once for every record REC (REC_SIZE bytes, bit LOG_FLAG_MASK
+	of the last byte is undefined) when its writing to record
+	SLOT (0..RECS-1) of ring is started; record SLOT+1 (modulo
+	RECS), the oldest record, is removed from log when REC is
+	written; EEPROM is free and the bus is granted (ReadEE may be
+	used) while the hook works; for example, for summaries of
+	records (see ee-logs-zone.h):
+		#define LOG_WRITE_HOOK( name, slot, rec )		\
+			Log_Hook ## name ( slot, rec )
+
+ LOG_VERIFY
+	Log_NoblockingWrite and Log_Flush read back every written chunk
+	(page or byte) by the next call, before the next chunk is
+	written (so verification costs only reads, no extra waiting
+	for EEPROM), and write the chunk again if it differs; record
+	is appended to log (Log_Commit) only after its last byte is
+	verified; chunk which is wrong after LOG_VERIFY_RETRIES
+	(default 3) rewritings is counted in Log_WriteErrors( NAME )
+	(up to 255) and writing goes on
+
+ LOG_SHARED_BUF
+	size of one buffer of record shared by all logs (not less than
+	the largest REC_SIZE, else LOGGER fails to compile) instead of
+	buffer of every log (for many logs on parts with small RAM);
+	define the buffer by LOG_SHARED_BUFFER() in one file; a log
+	owns the buffer from the start of writing of record by
+	Log_NoblockingWrite to its commit, Log_NoblockingWrite of other
+	log with SRC returns 0 while the buffer is owned (so the loop
+	must poll all logs, not one log until its record is started)
+
 
  Define these macros and functions:
 
@@ -52,10 +138,12 @@
 	size of record REC_SIZE in memory started at START_ADDR
 
 	must have:
-		2 <= REC_SIZE <= 255
+		2 <= REC_SIZE <= 127
 		2 <= RECS <= 255
 	one can use RECS-1 records (one record may be corrupted
-	and it never read)
+	and it never read);
+	if RECS is a power of 2, numbers of records are wrapped by
+	mask (no compare and branch in readers and writer)
 
  LOGGER( NAME, RECS, REC_SIZE, START_ADDR )
 	define log
@@ -64,6 +152,51 @@
 
 	Before work with a log one must initialize it with function Log_Init
 
+ LOG_SLOT_SIZE( REC_SIZE )
+	bytes of EEPROM used by one record (REC_SIZE if LOG_PAGE_ALIGN
+	is not defined); the log uses RECS * LOG_SLOT_SIZE( REC_SIZE )
+	bytes from START_ADDR
+
+ LOG_WRITE_CYCLES( REC_SIZE, START_ADDR )
+	write transactions (cycles of EEPROM) of one record written
+	by Log_NoblockingWrite: exact number if records of the log
+	never cross bound of page (see LOG_PAGE_ALIGN), else the
+	upper bound; a constant expression (not for #if)
+
+ Log_WriteCycles( NAME )
+	LOG_WRITE_CYCLES of log NAME (constant of enum defined by
+	LOGGER, so it is known in file of LOGGER only)
+
+ LOG_RAM( REC_SIZE )
+	bytes of RAM used by one log defined by LOGGER (buffer of
+	record, if it is not shared, and state of the log and of
+	Log_NoblockingWrite); a constant expression (not for #if)
+
+ Log_Ram( NAME ), Log_QueueRam( NAME )
+	LOG_RAM of log NAME and bytes of RAM used by its LOG_QUEUE
+	(constants of enum, as Log_WriteCycles)
+
+ struct Log_State, Log_State( NAME )
+	state of log in RAM (all logs have the same type of state, so
+	a scheduler may keep an array of pointers to states of logs):
+		pos	-- bit LOG_FLAG_MASK is the flag of records of
+			   the current pass of ring, other bits are
+			   bytes of record written by Log_NoblockingWrite
+			   (0 if it has no work)
+		rec	-- the free slot of ring (it is written now
+			   or the next record is written to it)
+		read	-- the 'current record'
+		ver, tries, errors -- bytes to verify, rewritings of
+			   chunk and Log_WriteErrors (only with LOG_VERIFY)
+	user must not change it
+
+ LOG_SHARED_BUFFER()
+	define the shared buffer of record (see LOG_SHARED_BUF)
+
+ LOG_SHARED_RAM
+	bytes of RAM of the shared buffer (0 if LOG_SHARED_BUF is not
+	defined)
+
 
  Log_Init( NAME )
 	initialize log with name NAME;
@@ -112,12 +245,54 @@
 	read the 'current record' of log NAME to adderss DST
 	(buffer at address DST must have REC_SIZE bytes);
 
+
+ DECLARE_LOG_QUEUE( NAME )
+	declare queue of appended records for log NAME
+
+ LOG_QUEUE( NAME, RECS, REC_SIZE, START_ADDR, QLEN )
+	define queue of QLEN records (1 <= QLEN <= 255) for log NAME;
+	must be placed after LOGGER( NAME, ... ) in the same file
+
+ Log_Append( NAME, void * SRC )
+	put record from address SRC to queue of log NAME;
+	return not 0 if the record is queued;
+	return 0 if the queue is full (nothing is done)
+
+ Log_Flush( NAME )
+	write queued records of log NAME to EEPROM; call this
+	function periodical;
+	return not 0 if the queue is empty and all writing is
+	terminated, else return 0;
+	if LOG_PAGE_SIZE is defined, the queued records which slots
+	follow one another in EEPROM (without wrap of the ring) are
+	written by one page-aligned transaction: firstly all bytes of
+	these records, but the last bytes of records get old flag (so
+	the ring stays valid if power is lost, only the first records of
+	the log may be corrupted), then the last bytes of records are
+	rewritten with new flag one by one in order of the records
+
+	Log_Flush waits while Log_NoblockingWrite is writing a record,
+	but Log_NoblockingWrite must not start writing to the log while
+	Log_Flush returns 0
+
 */
 
 
 #define LOG_FLAG_MASK	((unsigned char)0x80)
 
 
+struct Log_State {
+	unsigned char pos;
+	unsigned char rec;
+	unsigned char read;
+#ifdef LOG_VERIFY
+	unsigned char ver;
+	unsigned char tries;
+	unsigned char errors;
+#endif
+};
+
+
 #define DECLARE_LOGGER( name, recs, rec_size, start_addr )		\
 									\
 void Log_InitLog ## name ( void );					\
@@ -130,9 +305,9 @@ unsigned char Log_NoblockingWrite ## name ( const unsigned char * src );\
 static inline void							\
 Log_ReadCur ## name ( unsigned char * dst )				\
 {									\
-	extern unsigned char Log_CurReadRec__ ## name;			\
+	extern struct Log_State Log_State__ ## name;			\
 	void Log_ReadRec__ ## name ( unsigned char *, unsigned char );	\
-	Log_ReadRec__ ## name ( dst, Log_CurReadRec__ ## name );	\
+	Log_ReadRec__ ## name ( dst, Log_State__ ## name .read );	\
 }
 
 
@@ -143,7 +318,20 @@ Log_ReadCur ## name ( unsigned char * dst )				\
 #define Log_ReadPrev( name, dst )	Log_ReadPrev ## name ( dst )
 #define Log_NoblockingWrite( name, src )	\
 					Log_NoblockingWrite ## name ( src )
-#define Log_ReadCur( name, dsc )	Log_ReadCur ## name ( dst )
+#define Log_ReadCur( name, dst )	Log_ReadCur ## name ( dst )
+#define Log_Append( name, src )		Log_Append ## name ( src )
+#define Log_WriteCycles( name )		Log_WriteCycles__ ## name
+#define Log_WriteErrors( name )		Log_State__ ## name .errors
+#define Log_State( name )		Log_State__ ## name
+#define Log_Ram( name )			Log_Ram__ ## name
+#define Log_QueueRam( name )		Log_QueueRam__ ## name
+#define Log_Flush( name )		Log_Flush ## name ()
+
+
+#define DECLARE_LOG_QUEUE( name )					\
+									\
+unsigned char Log_Append ## name ( const unsigned char * src );		\
+unsigned char Log_Flush ## name ( void );
 
 
 /* ------------------------------------------------------------------- */
@@ -151,77 +339,337 @@ Log_ReadCur ## name ( unsigned char * dst )				\
 #define Log_ReadFlag( addr )  ( LOG_FLAG_MASK & ReadEE((void*)(addr)) )
 
 
+#ifdef LOG_BUS_ARBITER
+#define Log_BusAcquire()	LogBusAcquire()
+#define Log_BusRelease()	LogBusRelease()
+#define Log_BusWait()		do {} while ( !LogBusAcquire() )
+#ifndef LOG_BUS_CHUNK
+#define LOG_BUS_CHUNK	16
+#endif
+#else
+#define Log_BusAcquire()	((unsigned char)1)
+#define Log_BusRelease()	((void)0)
+#define Log_BusWait()		((void)0)
+#ifndef LOG_BUS_CHUNK
+#define LOG_BUS_CHUNK	255
+#endif
+#endif
+
+#ifdef LOG_WRITE_HOOK
+#define Log_WriteHook( name, slot, rec )	LOG_WRITE_HOOK( name, slot, rec )
+#define Log_HookAcquire()	Log_BusAcquire()
+#define Log_HookRelease()	Log_BusRelease()
+#else
+#define Log_WriteHook( name, slot, rec )	((void)0)
+#define Log_HookAcquire()	((unsigned char)1)
+#define Log_HookRelease()	((void)0)
+#endif
+
+/* give the bus to other clients after every LOG_BUS_CHUNK read bytes */
+#define Log_BusYield( cnt )						\
+	do {								\
+		if ( !((unsigned char)(cnt) % (LOG_BUS_CHUNK)) )	\
+		{ Log_BusRelease(); Log_BusWait(); }			\
+	} while ( 0 )
+
+
+#ifdef LOG_BURST_READ
+#define Log_ReadChunk( a, p, n )	ReadEEBlock( (void*)(a), (p), (n) )
+#else
+#define Log_ReadChunk( a, p, n )					\
+	do {								\
+		unsigned int a__ = (a);					\
+		unsigned char * p__ = (p);				\
+		unsigned char n__ = (n);				\
+		do {							\
+			*p__++ = ReadEE( (void*) a__ );			\
+			++a__;						\
+		} while ( --n__ );					\
+	} while ( 0 )
+#endif
+
+
+#ifdef LOG_PAGE_SIZE
+#define Log_WriteChunk( a, p, n )	WriteEEPage( (void*)(a), (p), (n) )
+
+/* number of bytes (no more than rem) from address a to end of page */
+static inline unsigned char
+Log_PageRoom( unsigned int a, unsigned char rem )
+{
+	unsigned int n = (LOG_PAGE_SIZE) - (a & ((LOG_PAGE_SIZE)-1));
+	return ( n < rem ) ? (unsigned char)n : rem;
+}
+#else
+#define Log_WriteChunk( a, p, n )	WriteEE( (void*)(a), *(p) )
+#define Log_PageRoom( a, rem )		((unsigned char)1)
+#endif
+
+
+/* layout of records */
+#ifdef LOG_PAGE_ALIGN
+#ifndef LOG_PAGE_SIZE
+#error "LOG_PAGE_ALIGN needs LOG_PAGE_SIZE"
+#endif
+#define Log_Pow2Up( n )							\
+	( (n) <= 2 ? 2 : (n) <= 4 ? 4 : (n) <= 8 ? 8 : (n) <= 16 ? 16	\
+	: (n) <= 32 ? 32 : (n) <= 64 ? 64 : (n) <= 128 ? 128 : 256 )
+#define LOG_SLOT_SIZE( rec_size )					\
+	( (rec_size) <= (LOG_PAGE_SIZE) ? Log_Pow2Up( rec_size )	\
+	: ((rec_size) + (LOG_PAGE_SIZE)-1) / (LOG_PAGE_SIZE) * (LOG_PAGE_SIZE) )
+#else
+#define LOG_SLOT_SIZE( rec_size )	(rec_size)
+#endif
+
+/* address of record r */
+#define Log_RecAddr( start_addr, rec_size, r )				\
+	( (unsigned int)(start_addr) + LOG_SLOT_SIZE( rec_size ) * (r) )
+
+#ifdef LOG_PAGE_SIZE
+/* no record crosses bound of page */
+#define Log_InPages( rec_size, start_addr )				\
+	( LOG_SLOT_SIZE( rec_size ) % (LOG_PAGE_SIZE)			\
+	? (LOG_PAGE_SIZE) % LOG_SLOT_SIZE( rec_size ) == 0		\
+		&& (start_addr) % LOG_SLOT_SIZE( rec_size ) == 0	\
+	: (start_addr) % (LOG_PAGE_SIZE) == 0 )
+
+/* pages with rec_size-1 bytes and the last byte of record */
+#define LOG_WRITE_CYCLES( rec_size, start_addr )			\
+	( Log_InPages( rec_size, start_addr )				\
+	? ((rec_size) + (LOG_PAGE_SIZE) - 2) / (LOG_PAGE_SIZE) + 1	\
+	: ((rec_size) + (LOG_PAGE_SIZE) - 3) / (LOG_PAGE_SIZE) + 2 )
+#else
+#define Log_InPages( rec_size, start_addr )	1
+#define LOG_WRITE_CYCLES( rec_size, start_addr )	(rec_size)
+#endif
+
+#ifdef LOG_PAGE_ALIGN
+#define Log_SlotAligned( rec_size, start_addr )				\
+	Log_InPages( rec_size, start_addr )
+#else
+#define Log_SlotAligned( rec_size, start_addr )	1
+#endif
+
+/* record after (before) record r of ring of recs records; recs is a
+   constant, so only one branch of the test of power of 2 is compiled */
+#define Log_IsPow2( n )		( !((n) & ((n)-1)) )
+
+#define Log_IncRec( r, recs )						\
+	do {								\
+		if ( Log_IsPow2( recs ) )				\
+			r = (unsigned char)(r + 1) & ((recs)-1);	\
+		else if ( r -= (recs)-1 ) r += (recs);			\
+	} while ( 0 )
+
+#define Log_DecRec( r, recs )						\
+	do {								\
+		if ( Log_IsPow2( recs ) )				\
+			r = (unsigned char)(r - 1) & ((recs)-1);	\
+		else if ( r ) -- r;					\
+		else r = (recs) - 1;					\
+	} while ( 0 )
+
+/* max number of records written by one transaction of Log_Flush */
+#ifdef LOG_PAGE_SIZE
+#define Log_MaxBatch	((unsigned char)255)
+#else
+#define Log_MaxBatch	((unsigned char)1)
+#endif
+
+/* flag of records of the current pass and bytes of record written by
+   Log_NoblockingWrite are packed into pos of state */
+#define Log_CurFlag( name )						\
+	( Log_State__ ## name .pos & LOG_FLAG_MASK )
+#define Log_Pos( name )							\
+	( Log_State__ ## name .pos & (unsigned char)~LOG_FLAG_MASK )
+
+/* verification of written chunks; only one branch of the tests of
+   Log_Verifying is compiled */
+#ifdef LOG_VERIFY
+#define Log_Verifying	1
+#ifndef LOG_VERIFY_RETRIES
+#define LOG_VERIFY_RETRIES	3
+#endif
+/* bytes of the last written chunk of Log_NoblockingWrite */
+#define Log_Ver( name )		Log_State__ ## name .ver
+#define Log_SetVer( name, n )	( Log_State__ ## name .ver = (n) )
+#else
+#define Log_Verifying	0
+#define LOG_VERIFY_RETRIES	0
+#define Log_Ver( name )		((unsigned char)0)
+#define Log_SetVer( name, n )	((void)0)
+#endif
+
+#ifdef LOG_VERIFY
+/* n bytes of EEPROM at address va are bytes from vp (the bus is
+   granted), else write them again (and return 0) or count error */
+#define Log_VerifyChunk( name, va, vp, n )				\
+	do {								\
+		unsigned int a__ = (va);				\
+		const unsigned char * p__ = (vp);			\
+		unsigned char n__ = (n);				\
+		while ( ReadEE( (void*) a__ ) == *p__ && --n__ )	\
+			{ ++a__; ++p__; }				\
+		if ( n__ )						\
+		{ /* differs */						\
+			if ( Log_State__ ## name .tries			\
+				< (LOG_VERIFY_RETRIES) )		\
+			{						\
+				++ Log_State__ ## name .tries;		\
+				if ( (n) == 1 ) WriteEE( (void*)(va), *(vp) );\
+				else Log_WriteChunk( va, vp, n );	\
+				Log_BusRelease();			\
+				return 0;				\
+			}						\
+			if ( !++ Log_WriteErrors( name ) )		\
+				-- Log_WriteErrors( name );		\
+		}							\
+		Log_State__ ## name .tries = 0;				\
+	} while ( 0 )
+#else
+/* vp is read only to keep its variables used */
+#define Log_VerifyChunk( name, va, vp, n )	do { (void)(vp); } while ( 0 )
+#endif
+
+
+/* buffer of record of log: its own or shared (it is owned while
+   Log_SharedBusy is not 0) */
+#ifdef LOG_SHARED_BUF
+extern unsigned char Log_SharedBuf[LOG_SHARED_BUF];
+extern unsigned char Log_SharedBusy;
+#define LOG_SHARED_BUFFER()						\
+	unsigned char Log_SharedBuf[LOG_SHARED_BUF];			\
+	unsigned char Log_SharedBusy;
+#define LOG_SHARED_RAM		( (LOG_SHARED_BUF) + 1 )
+/* error here: REC_SIZE is greater than LOG_SHARED_BUF */
+#define Log_DefRecBuf( name, rec_size )					\
+	typedef char Log_SharedFits__ ## name				\
+		[ (rec_size) <= (LOG_SHARED_BUF) ? 1 : -1 ];
+#define Log_RecBuf( name )	Log_SharedBuf
+#define Log_BufRam( rec_size )	0
+#define Log_BufTake()		( Log_SharedBusy ? 0 : (Log_SharedBusy = 1) )
+#define Log_BufFree()		( Log_SharedBusy = 0 )
+#else
+#define LOG_SHARED_RAM		0
+#define Log_DefRecBuf( name, rec_size )					\
+	static unsigned char Log_RecBuf__ ## name [rec_size];
+#define Log_RecBuf( name )	Log_RecBuf__ ## name
+#define Log_BufRam( rec_size )	(rec_size)
+#define Log_BufTake()		((unsigned char)1)
+#define Log_BufFree()		((void)0)
+#endif
+
+#define LOG_RAM( rec_size )						\
+	( Log_BufRam( rec_size ) + sizeof (struct Log_State) )
+
+
 
 #define LOGGER( name, recs, rec_size, start_addr )			\
 									\
-static unsigned char Log_RecBuf__ ## name [rec_size];			\
+enum {									\
+	Log_Recs__ ## name = (recs),					\
+	Log_WriteCycles__ ## name = LOG_WRITE_CYCLES( rec_size, start_addr ),\
+	Log_Ram__ ## name = LOG_RAM( rec_size )				\
+};									\
 									\
-static unsigned char Log_CurRec__ ## name;				\
-static unsigned char Log_CurFlag__ ## name;				\
+/* error here: START_ADDR is not aligned to slot (see LOG_PAGE_ALIGN) */\
+typedef char Log_Aligned__ ## name					\
+	[ Log_SlotAligned( rec_size, start_addr ) ? 1 : -1 ];		\
 									\
-unsigned char Log_CurReadRec__ ## name;	/* 'current record' */ 		\
+/* error here: REC_SIZE is not 2..127 (see pos of struct Log_State) */	\
+typedef char Log_SizeFits__ ## name					\
+	[ ((rec_size) >= 2 && (rec_size) <= 127) ? 1 : -1 ];		\
+									\
+Log_DefRecBuf( name, rec_size )						\
+									\
+struct Log_State Log_State__ ## name;					\
+									\
+/* the last byte of record of the free slot is written: append it */	\
+static void								\
+Log_Commit__ ## name ( void )						\
+{									\
+	unsigned char r = Log_State__ ## name .rec;			\
+	unsigned char i;						\
+	Log_IncRec( r, recs );						\
+	if ( !r ) Log_State__ ## name .pos ^= LOG_FLAG_MASK;		\
+	if ( (i = Log_State__ ## name .read) == r )			\
+	{								\
+		Log_IncRec( i, recs );					\
+		Log_State__ ## name .read = i;				\
+	}								\
+	Log_State__ ## name .rec = r;					\
+}									\
 									\
 void									\
 Log_ReadRec__ ## name ( unsigned char * dst, unsigned char r )		\
 {									\
-	unsigned char i = (rec_size)-1;					\
-	unsigned int a = (unsigned int)(start_addr) + r * (rec_size);	\
+	unsigned char i = (rec_size);					\
+	unsigned char n;						\
+	unsigned int a = Log_RecAddr( start_addr, rec_size, r );	\
+	unsigned char * p = dst;					\
 	do {								\
-		*dst++ = ReadEE( (void*) a );		 		\
-		++a;							\
-	} while ( --i );						\
-	*dst = (unsigned char)~LOG_FLAG_MASK & ReadEE( (void*) a );	\
+		n = ( i < (LOG_BUS_CHUNK) ) ? i : (LOG_BUS_CHUNK);	\
+		Log_BusWait();						\
+		Log_ReadChunk( a, p, n );				\
+		Log_BusRelease();					\
+		a += n; p += n;						\
+	} while ( i -= n );						\
+	dst[(rec_size)-1] &= (unsigned char)~LOG_FLAG_MASK;		\
 }									\
 									\
 void									\
 Log_InitLog ## name ( void )						\
 {									\
-	unsigned int a = (unsigned int)(start_addr) + (rec_size);	\
-	unsigned char f = Log_ReadFlag( a );				\
+	/* flag of record 0 (in its last byte) */			\
+	unsigned int a = (unsigned int)(start_addr) + (rec_size) - 1;	\
+	unsigned char f;						\
 	unsigned char cr = 1;						\
-	Log_CurFlag__ ## name = f;					\
+	Log_BusWait();							\
+	f = Log_ReadFlag( a );						\
+	Log_State__ ## name .pos = f;		/* (nothing is written) */\
 	do {								\
-		a += rec_size;						\
+		a += LOG_SLOT_SIZE( rec_size );				\
+		Log_BusYield( cr );					\
 		if ( (unsigned char)(f ^ Log_ReadFlag(a)) )		\
 		{							\
-			Log_CurRec__ ## name = cr;			\
-			if ( cr -= (recs)-1 ) cr += (recs);		\
-			Log_CurReadRec__ ## name = cr;			\
+			Log_BusRelease();				\
+			Log_State__ ## name .rec = cr;			\
+			Log_IncRec( cr, recs );				\
+			Log_State__ ## name .read = cr;			\
 			return;						\
 		}							\
 		++ cr;							\
 	} while ( cr < (recs) );					\
-	Log_CurRec__ ## name = 0;					\
-	Log_CurReadRec__ ## name = 1;					\
-	Log_CurFlag__ ## name = f ^ LOG_FLAG_MASK;			\
+	Log_BusRelease();						\
+	Log_State__ ## name .rec = 0;					\
+	Log_State__ ## name .read = 1;					\
+	Log_State__ ## name .pos = f ^ LOG_FLAG_MASK;			\
 }									\
 									\
 void									\
 Log_ReadFirst ## name ( unsigned char * dst )				\
 {									\
-	unsigned char r = Log_CurRec__ ## name;				\
-	if ( r -= (recs)-1 ) r += (recs);				\
-	Log_CurReadRec__ ## name = r;					\
+	unsigned char r = Log_State__ ## name .rec;			\
+	Log_IncRec( r, recs );						\
+	Log_State__ ## name .read = r;					\
 	Log_ReadRec__ ## name ( dst, r );				\
 }									\
 									\
 void									\
 Log_ReadLast ## name ( unsigned char * dst )				\
 {									\
-	unsigned char r = Log_CurRec__ ## name;				\
-	if ( r ) -- r;							\
-	else r = (recs) - 1;						\
-	Log_CurReadRec__ ## name = r;					\
+	unsigned char r = Log_State__ ## name .rec;			\
+	Log_DecRec( r, recs );						\
+	Log_State__ ## name .read = r;					\
 	Log_ReadRec__ ## name ( dst, r );				\
 }									\
 									\
 unsigned char								\
 Log_ReadNext ## name ( unsigned char * dst )				\
 {									\
-	unsigned char r = Log_CurReadRec__ ## name;			\
-	if ( r -= (recs)-1 ) r += (recs);				\
-	if ( r == Log_CurRec__ ## name ) return 0;			\
-	Log_CurReadRec__ ## name = r;					\
+	unsigned char r = Log_State__ ## name .read;			\
+	Log_IncRec( r, recs );						\
+	if ( r == Log_State__ ## name .rec ) return 0;			\
+	Log_State__ ## name .read = r;					\
 	Log_ReadRec__ ## name ( dst, r );				\
 	return 1;							\
 }									\
@@ -229,11 +677,10 @@ Log_ReadNext ## name ( unsigned char * dst )				\
 unsigned char								\
 Log_ReadPrev ## name ( unsigned char * dst )				\
 {									\
-	unsigned char r = Log_CurReadRec__ ## name;			\
-	if ( r ) -- r;							\
-	else r = (recs) - 1;						\
-	if ( r == Log_CurRec__ ## name ) return 0;			\
-	Log_CurReadRec__ ## name = r;					\
+	unsigned char r = Log_State__ ## name .read;			\
+	Log_DecRec( r, recs );						\
+	if ( r == Log_State__ ## name .rec ) return 0;			\
+	Log_State__ ## name .read = r;					\
 	Log_ReadRec__ ## name ( dst, r );				\
 	return 1;							\
 }									\
@@ -241,46 +688,182 @@ Log_ReadPrev ## name ( unsigned char * dst )				\
 unsigned char								\
 Log_NoblockingWrite ## name ( const unsigned char * src )		\
 {									\
-	static unsigned int a = 0;					\
-	static unsigned char i;						\
-	unsigned char * p;						\
+	struct Log_State * s = & Log_State__ ## name;			\
+	unsigned int a;							\
+	unsigned char i;						\
+	unsigned char n;						\
 	if ( !isEEfree() ) return 0;					\
-	if ( a )							\
-	{								\
-		if ( i == (rec_size) ) { a = 0; goto test; }		\
+	if ( Log_Verifying && Log_Ver( name ) )				\
+	{ /* read back the last written chunk */			\
+		n = Log_Ver( name );					\
+		i = Log_Pos( name ) - n;				\
+		if ( !Log_BusAcquire() ) return 0;			\
+		Log_VerifyChunk( name,					\
+			Log_RecAddr( start_addr, rec_size, s->rec ) + i,\
+			Log_RecBuf( name ) + i, n );			\
+		if ( i + n == (rec_size) )				\
+		{ /* the record is written */				\
+			Log_Commit__ ## name ();			\
+			Log_BufFree();					\
+			s->pos &= LOG_FLAG_MASK;			\
+		}							\
+		Log_SetVer( name, 0 );					\
+		Log_BusRelease();					\
+	}								\
+	if ( (i = Log_Pos( name )) )					\
+	{ /* write the next chunk of record */				\
+		if ( !Log_BusAcquire() ) return 0;			\
+		a = Log_RecAddr( start_addr, rec_size, s->rec ) + i;	\
 		if ( i == (rec_size)-1 )				\
 		{ /* write the last byte of record */			\
-			unsigned char r;				\
-			r = Log_RecBuf__ ## name [i];			\
-			r &= (unsigned char)~LOG_FLAG_MASK;		\
-			WriteEE( (void*) a, Log_CurFlag__ ## name | r );\
-			r = Log_CurRec__ ## name;			\
-			if ( r -= (recs)-1 ) r += (recs);		\
-			else Log_CurFlag__ ## name ^= LOG_FLAG_MASK;	\
-			if ( (i = Log_CurReadRec__ ## name) == r )	\
-				Log_CurReadRec__ ## name =		\
-					(i == (recs)-1) ? 0 : i + 1;	\
-			Log_CurRec__ ## name = r;			\
-			i = (rec_size);					\
+			n = Log_RecBuf( name ) [i];			\
+			n &= (unsigned char)~LOG_FLAG_MASK;		\
+			n |= Log_CurFlag( name );			\
+			Log_RecBuf( name ) [i] = n;			\
+			WriteEE( (void*) a, n );			\
+			n = 1;						\
 		} else {						\
-			WriteEE( (void*) a, Log_RecBuf__ ## name [i] );	\
-			++a; ++i;					\
+			n = Log_PageRoom( a, (rec_size)-1 - i );	\
+			Log_WriteChunk( a, Log_RecBuf( name ) + i, n );	\
 		}							\
+		s->pos += n; Log_SetVer( name, n );			\
+		if ( !Log_Verifying && i + n == (rec_size) )		\
+		{ /* the record is written */				\
+			Log_Commit__ ## name ();			\
+			Log_BufFree();					\
+			s->pos &= LOG_FLAG_MASK;			\
+		}							\
+		Log_BusRelease();					\
 		return 0;						\
 	}								\
-test:	if ( !src ) return 1;						\
-	a = (unsigned int)(start_addr)					\
-		+ (rec_size) * Log_CurRec__ ## name;			\
-	i = (rec_size)-1;						\
-	p = Log_RecBuf__ ## name;					\
-	WriteEE( (void*) a, *src++ );					\
-	++a;								\
-	*p++ = 1; /* Log_RecBuf__ ## name[0] = 1 */			\
+	if ( !src ) return 1;						\
+	if ( !Log_BusAcquire() ) return 0;				\
+	if ( !Log_BufTake() ) { Log_BusRelease(); return 0; }		\
+	a = Log_RecAddr( start_addr, rec_size, s->rec );		\
+	n = 0;								\
+	do {								\
+		Log_RecBuf( name ) [n] = src[n];			\
+	} while ( ++n < (rec_size) );					\
+	Log_WriteHook( name, s->rec, Log_RecBuf( name ) );		\
+	n = Log_PageRoom( a, (rec_size)-1 );				\
+	Log_WriteChunk( a, Log_RecBuf( name ), n );			\
+	s->pos |= n;							\
+	Log_SetVer( name, n );						\
+	Log_BusRelease();						\
+	return 1;							\
+}
+
+
+
+#define LOG_QUEUE( name, recs, rec_size, start_addr, qlen )		\
+									\
+/* the queue, Log_QHead__, Log_QCount__ and statics of Log_Flush */	\
+enum {									\
+	Log_QueueRam__ ## name = (qlen) * (rec_size) + 5		\
+		+ 3 * sizeof (unsigned int) + sizeof (unsigned char *)	\
+};									\
+									\
+static unsigned char Log_Queue__ ## name [qlen][rec_size];		\
+static unsigned char Log_QHead__ ## name;	/* the first queued */	\
+static unsigned char Log_QCount__ ## name;				\
+									\
+unsigned char								\
+Log_Append ## name ( const unsigned char * src )			\
+{									\
+	unsigned char i = Log_QHead__ ## name;				\
+	unsigned char * p;						\
+	if ( Log_QCount__ ## name == (qlen) ) return 0;			\
+	if ( (i += Log_QCount__ ## name) >= (qlen) ) i -= (qlen);	\
+	p = Log_Queue__ ## name [i];					\
+	i = (rec_size);							\
 	do {								\
-		*p++ = *src++ ;						\
+		*p++ = *src++;						\
 	} while ( --i );						\
-	i = 1;								\
+	++ Log_QCount__ ## name;					\
 	return 1;							\
+}									\
+									\
+/* the last byte of the first queued record is written: commit it */	\
+static void								\
+Log_Dequeue__ ## name ( unsigned char * k )				\
+{									\
+	Log_Commit__ ## name ();					\
+	if ( ++ Log_QHead__ ## name == (qlen) )				\
+		Log_QHead__ ## name = 0;				\
+	-- Log_QCount__ ## name;					\
+	-- *k;								\
+}									\
+									\
+unsigned char								\
+Log_Flush ## name ( void )						\
+{									\
+	static unsigned int a = 0;	/* next address of batch */	\
+	static unsigned int e = 0;	/* end of batch */		\
+	static unsigned char k = 0;	/* records to commit */		\
+	static unsigned int va;		/* chunk to verify */		\
+	static unsigned char * vp;					\
+	static unsigned char v = 0;					\
+	static unsigned char c = 0;	/* it is the last byte */	\
+	unsigned int b;							\
+	unsigned char * p;						\
+	unsigned char n;						\
+	if ( !isEEfree() ) return 0;					\
+	if ( Log_Verifying && v )					\
+	{ /* read back the last written chunk */			\
+		if ( !Log_BusAcquire() ) return 0;			\
+		Log_VerifyChunk( name, va, vp, v );			\
+		if ( c ) Log_Dequeue__ ## name ( &k );			\
+		v = c = 0;						\
+		Log_BusRelease();					\
+	}								\
+	if ( a != e )							\
+	{ /* write all bytes of batch with old flags */			\
+		if ( !Log_BusAcquire() ) return 0;			\
+		b = Log_RecAddr( start_addr, rec_size, Log_State__ ## name .rec );\
+		p = Log_Queue__ ## name [Log_QHead__ ## name] + (a - b);\
+		b = e - a;						\
+		n = Log_PageRoom( a, (b < 255) ? b : 255 );		\
+		Log_WriteChunk( a, p, n );				\
+		va = a; vp = p; v = n;					\
+		a += n;							\
+		Log_BusRelease();					\
+		return 0;						\
+	}								\
+	if ( k )							\
+	{ /* write the last byte of the next record with new flag */	\
+		if ( !Log_BusAcquire() ) return 0;			\
+		p = Log_Queue__ ## name [Log_QHead__ ## name] + (rec_size)-1;\
+		*p = Log_CurFlag( name ) | (*p & (unsigned char)~LOG_FLAG_MASK);\
+		va = Log_RecAddr( start_addr, rec_size, Log_State__ ## name .rec )\
+			+ (rec_size)-1;					\
+		WriteEE( (void*) va, *p );				\
+		if ( Log_Verifying ) { vp = p; v = c = 1; }		\
+		else Log_Dequeue__ ## name ( &k );			\
+		Log_BusRelease();					\
+		return 0;						\
+	}								\
+	if ( !Log_QCount__ ## name ) return Log_NoblockingWrite ## name (0);\
+	if ( !Log_NoblockingWrite ## name (0) ) return 0;		\
+	/* form a batch: slots and queue entries follow one another */	\
+	k = (recs) - Log_State__ ## name .rec;				\
+	if ( k > Log_QCount__ ## name ) k = Log_QCount__ ## name;	\
+	if ( k > (qlen) - Log_QHead__ ## name )				\
+		k = (qlen) - Log_QHead__ ## name;			\
+	if ( Log_MaxBatch == 1 ) k = 1;	/* (k is not more than 255) */	\
+	if ( LOG_SLOT_SIZE( rec_size ) != (rec_size) ) k = 1;		\
+	if ( !Log_HookAcquire() ) { k = 0; return 0; }			\
+	n = 0;								\
+	do {								\
+		p = Log_Queue__ ## name [Log_QHead__ ## name + n];	\
+		Log_WriteHook( name, Log_State__ ## name .rec + n, p );	\
+		p += (rec_size)-1;					\
+		*p = (*p & (unsigned char)~LOG_FLAG_MASK)		\
+			| (Log_CurFlag( name ) ^ LOG_FLAG_MASK);	\
+	} while ( ++n < k );						\
+	Log_HookRelease();						\
+	a = Log_RecAddr( start_addr, rec_size, Log_State__ ## name .rec );\
+	e = a + (rec_size) * k - 1;					\
+	return 0;							\
 }
 
 
@@ -0,0 +1,142 @@
+/* ee-image.h */
+/*
+ Logs in image of EEPROM (for programs on host computer)
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Image of EEPROM is an array of bytes read from device
+	(byte K of image is byte of EEPROM at address K).
+
+	Log_RingInit finds the ring of log in image by the same way
+	as Log_Init of ee-logs.h does: the 'free' record of ring is the
+	first record which flag differs from flag of record 0 (or record
+	0 if all records have the same flag).  Then record after the
+	'free' record is the first (the oldest) record of the log and
+	record before the 'free' record is the last one; a log always
+	has RECS-1 records.
+
+	Nothing is allocated, image is not changed.
+*/
+
+#ifndef EE_IMAGE_H
+#define EE_IMAGE_H
+
+
+#define LOG_FLAG_MASK	((unsigned char)0x80)
+
+
+struct Log_Geom {
+	unsigned recs;			/* number of records in ring */
+	unsigned rec_size;		/* size of record */
+	unsigned long start;		/* address of ring in EEPROM */
+	unsigned slot;			/* bytes of record in EEPROM (0 --
+					   rec_size, see LOG_PAGE_ALIGN) */
+};
+
+struct Log_Ring {
+	const unsigned char * img;
+	unsigned long len;		/* bytes in image */
+	struct Log_Geom g;
+	unsigned cur;			/* the 'free' record of ring */
+};
+
+
+/* LOG_SLOT_SIZE of ee-logs.h for LOG_PAGE_SIZE page (power of 2) */
+static inline unsigned
+Log_SlotSize( unsigned rec_size, unsigned page )
+{
+	unsigned s = 2;
+	if ( rec_size > page ) return (rec_size + page - 1) / page * page;
+	while ( s < rec_size ) s <<= 1;
+	return s;
+}
+
+
+/*
+	find ring of log with geometry g in image img of len bytes;
+	return 0 if ring is found;
+	return -1 if geometry is wrong or ring is out of image
+*/
+static int
+Log_RingInit( struct Log_Ring * r, const unsigned char * img,
+		unsigned long len, const struct Log_Geom * g )
+{
+	unsigned long a;
+	unsigned char f;
+	unsigned cr, s = g->slot ? g->slot : g->rec_size;
+
+	if ( g->recs < 2 || g->recs > 255
+		|| g->rec_size < 2 || g->rec_size > 255
+		|| s < g->rec_size || s > 0xFFFF
+		|| g->start > len
+		|| len - g->start < (unsigned long)(g->recs - 1) * s + g->rec_size )
+		return -1;
+	r->img = img;
+	r->len = len;
+	r->g = *g;
+	r->g.slot = s;
+
+	a = g->start + g->rec_size - 1;		/* last byte of record 0 */
+	f = img[a] & LOG_FLAG_MASK;
+	for ( cr = 1; cr < g->recs; ++cr )
+	{
+		a += s;
+		if ( (img[a] & LOG_FLAG_MASK) != f )
+		{
+			r->cur = cr;
+			return 0;
+		}
+	}
+	r->cur = 0;
+	return 0;
+}
+
+#define Log_RingCount( r )	( (r)->g.recs - 1 )
+
+/* slot of K-th record of log (from the oldest one) */
+static inline unsigned
+Log_RingSlot( const struct Log_Ring * r, unsigned k )
+{
+	unsigned s = r->cur + 1 + k;
+	if ( s >= r->g.recs ) s -= r->g.recs;
+	return s;
+}
+
+/* K-th record of log (the flag is not cleared) */
+static inline const unsigned char *
+Log_RingRec( const struct Log_Ring * r, unsigned k )
+{
+	return r->img + r->g.start
+		+ (unsigned long) Log_RingSlot( r, k ) * r->g.slot;
+}
+
+/* copy K-th record of log to dst as Log_Read* functions do */
+static inline void
+Log_RingCopy( const struct Log_Ring * r, unsigned k, unsigned char * dst )
+{
+	const unsigned char * p = Log_RingRec( r, k );
+	unsigned i;
+	for ( i = 0; i < r->g.rec_size; ++i ) dst[i] = p[i];
+	dst[r->g.rec_size - 1] &= (unsigned char)~LOG_FLAG_MASK;
+}
+
+#endif /* EE_IMAGE_H */
+
+
+/* End of file  ee-image.h */
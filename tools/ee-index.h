@@ -0,0 +1,307 @@
+/* ee-index.h */
+/*
+ Sidecar index of logs in image of EEPROM (for programs on host computer)
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Index of image IMAGE is kept in file IMAGE.idx near the image.
+	It has:
+		size and time of modification of the image (index of other
+		image or of old image is not used);
+		geometry of log (with size of slot of record, see
+		LOG_PAGE_ALIGN) and layout of records: offset and width
+		of timestamp (little endian, 1..4 bytes), offset of byte
+		with event (index in dictionary of ee-logs-dict.h);
+		summary of the whole log: min and max timestamp and bitmap
+		of events present in log;
+		the same summary for every block of LOG_IDX_BLOCK records
+		(from the oldest record);
+		address in image of every record of log (from the oldest).
+
+	A query reads index only and skips image if summary of log does
+	not match; else it reads (by the addresses) only records of
+	matched blocks.
+
+	Index is not trusted: Log_IdxParse checks every field, so
+	layout and addresses of parsed index are always inside record
+	and inside image of img_len bytes.
+
+	All numbers in file are 32-bit little endian.
+
+	ee-image.h must be included before this file.
+*/
+
+#ifndef EE_INDEX_H
+#define EE_INDEX_H
+
+#include <stdio.h>
+#include <string.h>
+
+
+#define LOG_IDX_MAGIC	0x58494C45UL	/* "ELIX" */
+#define LOG_IDX_VERSION	2
+#define LOG_IDX_BLOCK	16		/* records in block */
+#define LOG_IDX_NONE	0xFFFFu		/* no timestamp or no event */
+#define LOG_IDX_MAXBLK	((255 + LOG_IDX_BLOCK - 1) / LOG_IDX_BLOCK)
+
+/* sizes in file: header, summary, the largest index */
+#define LOG_IDX_HDRSIZE	(12 * 4)
+#define LOG_IDX_SUMSIZE	(2 * 4 + 32)
+#define LOG_IDX_MAXSIZE	(LOG_IDX_HDRSIZE + (1 + LOG_IDX_MAXBLK) * LOG_IDX_SUMSIZE\
+			+ 255 * 4)
+
+
+struct Log_IdxSum {
+	unsigned long tmin, tmax;	/* timestamps */
+	unsigned char ev[32];		/* bit K: event K is present */
+};
+
+struct Log_Index {
+	unsigned long img_len, img_time;
+	struct Log_Geom g;
+	unsigned ts_off, ts_width;	/* ts_off is LOG_IDX_NONE if no */
+	unsigned ev_off;		/* LOG_IDX_NONE if no */
+	unsigned count;			/* records in log */
+	struct Log_IdxSum all;
+	struct Log_IdxSum blk[LOG_IDX_MAXBLK];
+	unsigned long addr[255];	/* address of K-th record */
+};
+
+/* query: records with timestamp in [tmin, tmax] and event ev */
+struct Log_IdxQuery {
+	unsigned long tmin, tmax;
+	int ev;				/* -1: any event */
+};
+
+
+/* timestamp of record (flag is cleared) */
+static inline unsigned long
+Log_IdxTs( const struct Log_Index * x, const unsigned char * rec )
+{
+	unsigned long t = 0;
+	unsigned i;
+	if ( x->ts_off == LOG_IDX_NONE ) return 0;
+	for ( i = x->ts_width; i--; ) t = (t << 8) | rec[x->ts_off + i];
+	return t;
+}
+
+static inline void
+Log_IdxAdd( struct Log_IdxSum * s, unsigned long t, int ev, int first )
+{
+	if ( first || t < s->tmin ) s->tmin = t;
+	if ( first || t > s->tmax ) s->tmax = t;
+	if ( first ) memset( s->ev, 0, sizeof s->ev );
+	if ( ev >= 0 ) s->ev[ev >> 3] |= (unsigned char)(1u << (ev & 7));
+}
+
+/* return not 0 if some records summarized by s may match query q */
+static inline int
+Log_IdxMayMatch( const struct Log_Index * x, const struct Log_IdxSum * s,
+		const struct Log_IdxQuery * q )
+{
+	if ( x->ts_off != LOG_IDX_NONE && (s->tmax < q->tmin || s->tmin > q->tmax) )
+		return 0;
+	if ( q->ev >= 0 && x->ev_off != LOG_IDX_NONE
+		&& !(s->ev[q->ev >> 3] & (1u << (q->ev & 7))) )
+		return 0;
+	return 1;
+}
+
+/* return not 0 if record rec matches query q */
+static inline int
+Log_IdxMatch( const struct Log_Index * x, const unsigned char * rec,
+		const struct Log_IdxQuery * q )
+{
+	unsigned long t = Log_IdxTs( x, rec );
+	if ( x->ts_off != LOG_IDX_NONE && (t < q->tmin || t > q->tmax) ) return 0;
+	if ( q->ev >= 0 && x->ev_off != LOG_IDX_NONE && rec[x->ev_off] != q->ev )
+		return 0;
+	return 1;
+}
+
+
+/*
+	build index of ring r; ts_off, ev_off are LOG_IDX_NONE if records
+	have no timestamp or no event;
+	return -1 if layout of record is out of record
+*/
+static int
+Log_IdxBuild( struct Log_Index * x, const struct Log_Ring * r,
+		unsigned ts_off, unsigned ts_width, unsigned ev_off )
+{
+	unsigned char rec[255];
+	unsigned k;
+
+	if ( (ts_off != LOG_IDX_NONE
+		&& (ts_width < 1 || ts_width > 4
+			|| ts_off + ts_width > r->g.rec_size))
+		|| (ev_off != LOG_IDX_NONE && ev_off >= r->g.rec_size) )
+		return -1;
+	memset( x, 0, sizeof *x );
+	x->img_len = r->len;
+	x->g = r->g;
+	x->ts_off = ts_off;
+	x->ts_width = ts_width;
+	x->ev_off = ev_off;
+	x->count = Log_RingCount( r );
+	for ( k = 0; k < x->count; ++k )
+	{
+		unsigned long t;
+		int ev;
+		Log_RingCopy( r, k, rec );
+		t = Log_IdxTs( x, rec );
+		ev = ev_off == LOG_IDX_NONE ? -1 : rec[ev_off];
+		x->addr[k] = (unsigned long)( Log_RingRec( r, k ) - r->img );
+		Log_IdxAdd( &x->all, t, ev, k == 0 );
+		Log_IdxAdd( &x->blk[k / LOG_IDX_BLOCK], t, ev,
+			k % LOG_IDX_BLOCK == 0 );
+	}
+	return 0;
+}
+
+
+static void
+Log_IdxPut( FILE * f, unsigned long v )
+{
+	putc( (int)(v & 0xFF), f );
+	putc( (int)((v >> 8) & 0xFF), f );
+	putc( (int)((v >> 16) & 0xFF), f );
+	putc( (int)((v >> 24) & 0xFF), f );
+}
+
+static void
+Log_IdxPutSum( FILE * f, const struct Log_IdxSum * s )
+{
+	Log_IdxPut( f, s->tmin );
+	Log_IdxPut( f, s->tmax );
+	fwrite( s->ev, 1, sizeof s->ev, f );
+}
+
+/* write index to file fn; return 0 on success */
+static int
+Log_IdxSave( const char * fn, const struct Log_Index * x )
+{
+	unsigned k;
+	int e;
+	FILE * f = fopen( fn, "wb" );
+	if ( !f ) return -1;
+	Log_IdxPut( f, LOG_IDX_MAGIC );
+	Log_IdxPut( f, LOG_IDX_VERSION );
+	Log_IdxPut( f, x->img_len );
+	Log_IdxPut( f, x->img_time );
+	Log_IdxPut( f, x->g.recs );
+	Log_IdxPut( f, x->g.rec_size );
+	Log_IdxPut( f, x->g.start );
+	Log_IdxPut( f, x->ts_off );
+	Log_IdxPut( f, x->ts_width );
+	Log_IdxPut( f, x->ev_off );
+	Log_IdxPut( f, x->count );
+	Log_IdxPut( f, x->g.slot );
+	Log_IdxPutSum( f, &x->all );
+	for ( k = 0; k < (x->count + LOG_IDX_BLOCK - 1) / LOG_IDX_BLOCK; ++k )
+		Log_IdxPutSum( f, &x->blk[k] );
+	for ( k = 0; k < x->count; ++k ) Log_IdxPut( f, x->addr[k] );
+	e = ferror( f );
+	return fclose( f ) || e ? -1 : 0;
+}
+
+static inline unsigned long
+Log_IdxGet( const unsigned char * p )
+{
+	return p[0] | (unsigned long) p[1] << 8
+		| (unsigned long) p[2] << 16 | (unsigned long) p[3] << 24;
+}
+
+static const unsigned char *
+Log_IdxGetSum( const unsigned char * p, struct Log_IdxSum * s )
+{
+	s->tmin = Log_IdxGet( p );
+	s->tmax = Log_IdxGet( p + 4 );
+	memcpy( s->ev, p + 8, sizeof s->ev );
+	return p + LOG_IDX_SUMSIZE;
+}
+
+/*
+	parse index from n bytes at buf (any bytes: file of index is
+	not trusted); nothing is allocated;
+	return 0 if index is right;
+	return -1 if index is broken (then x is undefined)
+*/
+static int
+Log_IdxParse( struct Log_Index * x, const unsigned char * buf,
+		unsigned long n )
+{
+	unsigned long v[12];
+	unsigned k, nb;
+
+	if ( n < LOG_IDX_HDRSIZE ) return -1;
+	for ( k = 0; k < 12; ++k ) v[k] = Log_IdxGet( buf + 4 * k );
+	if ( v[0] != LOG_IDX_MAGIC || v[1] != LOG_IDX_VERSION
+		|| v[4] < 2 || v[4] > 255 || v[5] < 2 || v[5] > 255
+		|| v[10] >= v[4] || v[2] < v[5] || v[11] < v[5] || v[11] > 0xFFFF )
+		return -1;
+	if ( v[7] != LOG_IDX_NONE				/* timestamp */
+		&& (v[7] >= v[5] || v[8] < 1 || v[8] > 4 || v[7] + v[8] > v[5]) )
+		return -1;
+	if ( v[9] != LOG_IDX_NONE && v[9] >= v[5] )		/* event */
+		return -1;
+	nb = (v[10] + LOG_IDX_BLOCK - 1) / LOG_IDX_BLOCK;
+	if ( n != LOG_IDX_HDRSIZE + (1 + nb) * LOG_IDX_SUMSIZE + 4 * v[10] )
+		return -1;
+
+	x->img_len = v[2];
+	x->img_time = v[3];
+	x->g.recs = v[4];
+	x->g.rec_size = v[5];
+	x->g.start = v[6];
+	x->ts_off = v[7];
+	x->ts_width = v[8];
+	x->ev_off = v[9];
+	x->count = v[10];
+	x->g.slot = v[11];
+	buf = Log_IdxGetSum( buf + LOG_IDX_HDRSIZE, &x->all );
+	for ( k = 0; k < nb; ++k ) buf = Log_IdxGetSum( buf, &x->blk[k] );
+	for ( k = 0; k < x->count; ++k, buf += 4 )
+	{
+		x->addr[k] = Log_IdxGet( buf );
+		if ( x->addr[k] > x->img_len - x->g.rec_size ) return -1;
+	}
+	return 0;
+}
+
+/*
+	read index from file fn;
+	return -1 if there is no index or index is broken
+*/
+static int
+Log_IdxLoad( const char * fn, struct Log_Index * x )
+{
+	unsigned char b[LOG_IDX_MAXSIZE + 1];
+	size_t n;
+	FILE * f = fopen( fn, "rb" );
+	if ( !f ) return -1;
+	n = fread( b, 1, sizeof b, f );
+	fclose( f );
+	return Log_IdxParse( x, b, n );
+}
+
+#endif /* EE_INDEX_H */
+
+
+/* End of file  ee-index.h */
@@ -0,0 +1,462 @@
+/* ee-logs-bench.c */
+/*
+ Speed and EEPROM operations of every function of ee-logs.h
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host):
+	cc -O2 -o ee-logs-bench ee-logs-bench.c
+	cc -O2 -DLOG_PAGE_SIZE=32 -DLOG_BURST_READ -o ee-logs-bench-pg	\
+		ee-logs-bench.c
+	cc -O2 -DBENCH_BLOOM -o ee-logs-bench-bloom ee-logs-bench.c
+	cc -O2 -DLOG_SHARED_BUF=64 -o ee-logs-bench-shared ee-logs-bench.c
+
+	(options of ee-logs.h and EE_SIM_BUSY of ee-sim.h are set by -D)
+
+ Usage:
+	ee-logs-bench [-t MS] [-j]
+
+	For every log of matrix RECS x REC_SIZE (see BENCH_MATRIX) on
+	simulated EEPROM (see ee-sim.h) measures:
+		init	-- Log_Init
+		first	-- Log_ReadFirst
+		last	-- Log_ReadLast
+		next	-- Log_ReadNext (walk from the first record)
+		prev	-- Log_ReadPrev (walk from the last record)
+		cur	-- Log_ReadCur
+		append	-- Log_NoblockingWrite of record and polling
+			   until writing is terminated
+		dump	-- Log_ReadFirst and Log_ReadNext of all records
+
+	Every operation is repeated at least MS milliseconds (default
+	50); time per operation (ns), EEPROM transactions and bytes per
+	operation are printed as table or as JSON (-j) for tracking of
+	regressions.  Then bytes of RAM of every log (Log_Ram of
+	ee-logs.h), of all logs and of the shared buffer of record (if
+	LOG_SHARED_BUF is defined, not less than the largest REC_SIZE
+	of BENCH_MATRIX) are printed.
+
+	If BENCH_BLOOM is defined, every log has Bloom filters of
+	ee-logs-bloom.h (code of event in byte 0, blocks of BENCH_BLOCK
+	records, default 16; append includes Log_BloomNote) and for
+	every log the ring is filled with records with BENCH_CODES
+	(default 16) random codes and printed:
+		ram	-- bytes of RAM of filters
+		fp	-- false positive rate (part of filters of blocks
+			   which have a code of absent event)
+		query	-- Log_BloomLast of absent event (ns, EEPROM
+			   transactions and bytes)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EE_SIM_DEVICE
+#ifndef EE_SIM_SIZE
+#define EE_SIM_SIZE	(255 * 64)
+#endif
+#ifdef BENCH_BLOOM
+#define LOG_WRITE_HOOK( name, slot, rec )				\
+	Log_BloomNote ## name ( slot, rec )
+#endif
+#include "ee-sim.h"
+#include "../ee-logs.h"
+#ifdef LOG_SHARED_BUF
+LOG_SHARED_BUFFER()
+#endif
+#ifdef BENCH_BLOOM
+#include "../ee-logs-bloom.h"
+#ifndef BENCH_BLOCK
+#define BENCH_BLOCK	16
+#endif
+#ifndef BENCH_CODES
+#define BENCH_CODES	16
+#endif
+#endif
+
+
+/* RECS and REC_SIZE of benchmarked logs */
+#define BENCH_MATRIX( X )						\
+	X( 8, 4 )	X( 8, 16 )	X( 8, 64 )			\
+	X( 64, 4 )	X( 64, 16 )	X( 64, 64 )			\
+	X( 255, 4 )	X( 255, 16 )	X( 255, 64 )
+
+
+#ifdef BENCH_BLOOM
+#define BENCH_BLOCK_OF( r )	( (r) < BENCH_BLOCK ? (r) : BENCH_BLOCK )
+#define BENCH_FILTER( n, r, s )						\
+									\
+DECLARE_LOG_BLOOM( n )							\
+LOGGER( n, r, s, 0 )							\
+LOG_BLOOM( n, r, s, 0, 1, BENCH_BLOCK_OF( r ) )				\
+									\
+static unsigned n ## _pass( unsigned code )				\
+{									\
+	unsigned k, c = 0;						\
+	for ( k = 0; k < sizeof Log_Bloom__ ## n / LOG_BLOOM_BYTES; ++k )\
+		c += Log_BloomBits( Log_Bloom__ ## n [k], code, 0 );	\
+	return c;							\
+}									\
+static void n ## _build( void ) { Log_BloomBuild( n ); }		\
+static unsigned char n ## _query( unsigned code, unsigned char * d )	\
+{ return Log_BloomLast( n, code, d ); }
+
+#define BENCH_FILTER_REF( n, r )					\
+									\
+static const struct Bench_Bloom n ## _bloom = {				\
+	&n, BENCH_BLOCK_OF( r ), sizeof Log_Bloom__ ## n,		\
+	sizeof Log_Bloom__ ## n / LOG_BLOOM_BYTES,			\
+	n ## _pass, n ## _build, n ## _query				\
+};
+#define BENCH_BLOOM_REF( r, s )	&B_ ## r ## _ ## s ## _bloom,
+
+struct Bench_Bloom {
+	const struct Log_Engine * g;
+	unsigned block, ram, blocks;
+	unsigned (* pass)( unsigned code );	/* filters with code */
+	void (* build)( void );
+	unsigned char (* query)( unsigned code, unsigned char * dst );
+};
+#else
+#define BENCH_FILTER( n, r, s )		LOGGER( n, r, s, 0 )
+#define BENCH_FILTER_REF( n, r )
+#endif
+
+
+#define BENCH_CELL( r, s )	BENCH_CELL__( B_ ## r ## _ ## s, r, s )
+#define BENCH_CELL__( n, r, s )						\
+									\
+DECLARE_LOGGER( n, r, s, 0 )						\
+BENCH_FILTER( n, r, s )							\
+									\
+static void n ## _init( void ) { Log_Init( n ); }			\
+static void n ## _append( const unsigned char * src )			\
+{ while ( !Log_NoblockingWrite( n, src ) ) ; }				\
+static void n ## _sync( void ) { while ( !Log_NoblockingWrite( n, 0 ) ) ; }\
+static void n ## _first( unsigned char * d ) { Log_ReadFirst( n, d ); }	\
+static void n ## _last( unsigned char * d ) { Log_ReadLast( n, d ); }	\
+static unsigned char n ## _next( unsigned char * d )			\
+{ return Log_ReadNext( n, d ); }					\
+static unsigned char n ## _prev( unsigned char * d )			\
+{ return Log_ReadPrev( n, d ); }					\
+static void n ## _cur( unsigned char * d ) { Log_ReadCur( n, d ); }	\
+									\
+static const struct Log_Engine n = {					\
+	#n, r, s, 0, Ee_Mem, sizeof Ee_Mem, &Ee_Stat,			\
+	n ## _init, n ## _append, n ## _sync, n ## _first, n ## _last,	\
+	n ## _next, n ## _prev, n ## _cur				\
+};									\
+BENCH_FILTER_REF( n, r )
+
+#define BENCH_REF( r, s )	&B_ ## r ## _ ## s,
+#define BENCH_RAM( r, s )	Log_Ram( B_ ## r ## _ ## s ),
+
+BENCH_MATRIX( BENCH_CELL )
+
+static const struct Log_Engine * const cells[] = { BENCH_MATRIX( BENCH_REF ) };
+static const unsigned rams[] = { BENCH_MATRIX( BENCH_RAM ) };
+#ifdef BENCH_BLOOM
+static const struct Bench_Bloom * const blooms[] = {
+	BENCH_MATRIX( BENCH_BLOOM_REF )
+};
+#endif
+
+
+enum { OP_INIT, OP_FIRST, OP_LAST, OP_NEXT, OP_PREV, OP_CUR, OP_APPEND,
+	OP_DUMP, NOPS };
+
+static const char * op_name[NOPS] = {
+	"init", "first", "last", "next", "prev", "cur", "append", "dump"
+};
+
+struct Result {
+	unsigned long n;		/* operations */
+	double ns;			/* time of all operations */
+	unsigned long ops, bytes;	/* EEPROM transactions and bytes */
+};
+
+
+static double
+now_ns( void )
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/* do operations op of log g at least min_ns nanoseconds */
+static void
+measure( const struct Log_Engine * g, int op, double min_ns, struct Result * r )
+{
+	unsigned char rec[255];
+	unsigned long o, b;
+	unsigned k;
+
+	memset( r, 0, sizeof *r );
+	for ( k = 0; k < g->rec_size; ++k ) rec[k] = (unsigned char)(k * 37);
+	g->sync();
+	g->init();
+	while ( r->ns < min_ns )
+	{
+		double t;
+		unsigned long n = 0;
+		if ( op == OP_NEXT ) g->first( rec );
+		if ( op == OP_PREV ) g->last( rec );
+		o = Ee_SimOps( g->stat );
+		b = g->stat->bytes_read + g->stat->bytes_written;
+		t = now_ns();
+		switch ( op )
+		{
+		case OP_INIT:
+			for ( ; n < 64; ++n ) g->init();
+			break;
+		case OP_FIRST:
+			for ( ; n < 64; ++n ) g->first( rec );
+			break;
+		case OP_LAST:
+			for ( ; n < 64; ++n ) g->last( rec );
+			break;
+		case OP_NEXT:
+			do ++n; while ( g->next( rec ) );
+			break;
+		case OP_PREV:
+			do ++n; while ( g->prev( rec ) );
+			break;
+		case OP_CUR:
+			for ( ; n < 64; ++n ) g->cur( rec );
+			break;
+		case OP_APPEND:
+			for ( ; n < 64; ++n ) { g->append( rec ); g->sync(); }
+			break;
+		default: /* OP_DUMP */
+			for ( ; n < 4; ++n )
+			{
+				g->first( rec );
+				while ( g->next( rec ) ) ;
+			}
+		}
+		r->ns += now_ns() - t;
+		r->n += n;
+		r->ops += Ee_SimOps( g->stat ) - o;
+		r->bytes += g->stat->bytes_read + g->stat->bytes_written - b;
+	}
+}
+
+#ifdef BENCH_BLOOM
+struct Bloom_Result {
+	double fp;			/* false positive rate */
+	struct Result q;		/* queries of absent codes */
+};
+
+/* fill ring of log of f with BENCH_CODES codes (from 0..127) and
+   query absent codes (128..255) at least min_ns nanoseconds */
+static void
+measure_bloom( const struct Bench_Bloom * f, double min_ns,
+		struct Bloom_Result * r )
+{
+	const struct Log_Engine * g = f->g;
+	unsigned char codes[BENCH_CODES];
+	unsigned char rec[255];
+	unsigned long o, b, pass = 0;
+	unsigned k, c;
+
+	memset( r, 0, sizeof *r );
+	for ( k = 0; k < BENCH_CODES; ++k ) codes[k] = (unsigned char)(rand() & 127);
+	for ( k = 0; k < g->rec_size; ++k ) rec[k] = (unsigned char)(k * 37);
+	g->sync();
+	g->init();
+	f->build();
+	for ( k = 0; k < g->recs; ++k )
+	{
+		rec[0] = codes[rand() % BENCH_CODES];
+		g->append( rec );
+		g->sync();
+	}
+	for ( c = 128; c < 256; ++c ) pass += f->pass( c );
+	r->fp = (double) pass / (128.0 * f->blocks);
+
+	c = 128;
+	while ( r->q.ns < min_ns )
+	{
+		double t;
+		unsigned long n = 0;
+		o = Ee_SimOps( g->stat );
+		b = g->stat->bytes_read + g->stat->bytes_written;
+		t = now_ns();
+		for ( ; n < 64; ++n )
+		{
+			f->query( c, rec );
+			if ( ++c == 256 ) c = 128;
+		}
+		r->q.ns += now_ns() - t;
+		r->q.n += n;
+		r->q.ops += Ee_SimOps( g->stat ) - o;
+		r->q.bytes += g->stat->bytes_read + g->stat->bytes_written - b;
+	}
+}
+#endif
+
+
+int
+main( int argc, char ** argv )
+{
+	double min_ns = 50e6;
+	int json = 0, c, op;
+	unsigned k;
+	const char * sep = "";
+	unsigned ram = LOG_SHARED_RAM;
+
+	while ( (c = getopt( argc, argv, "t:j" )) != -1 )
+	{
+		switch ( c )
+		{
+		case 't': min_ns = strtod( optarg, 0 ) * 1e6; break;
+		case 'j': json = 1; break;
+		default:
+			fprintf( stderr, "usage: %s [-t MS] [-j]\n", argv[0] );
+			return 2;
+		}
+	}
+	for ( k = 0; k < sizeof Ee_Mem; ++k ) Ee_Mem[k] = (unsigned char) rand();
+
+	if ( json )
+	{
+		printf( "{\n  \"config\": { \"page_size\": %d, \"page_align\": %d,"
+			" \"burst_read\": %d, \"verify\": %d,"
+			" \"shared_buf\": %d, \"busy\": %d },\n  \"results\": [",
+#ifdef LOG_PAGE_SIZE
+			LOG_PAGE_SIZE,
+#else
+			0,
+#endif
+#ifdef LOG_PAGE_ALIGN
+			1,
+#else
+			0,
+#endif
+#ifdef LOG_BURST_READ
+			1,
+#else
+			0,
+#endif
+			Log_Verifying,
+#ifdef LOG_SHARED_BUF
+			LOG_SHARED_BUF,
+#else
+			0,
+#endif
+			EE_SIM_BUSY );
+	}
+	else
+		printf( "%5s %8s %-7s %12s %12s %12s %10s\n", "recs", "rec_size",
+			"op", "ns/op", "ee ops/op", "ee bytes/op", "count" );
+
+	for ( k = 0; k < sizeof cells / sizeof cells[0]; ++k )
+	{
+		const struct Log_Engine * g = cells[k];
+		for ( op = 0; op < NOPS; ++op )
+		{
+			struct Result r;
+			measure( g, op, min_ns, &r );
+			if ( json )
+			{
+				printf( "%s\n    { \"recs\": %u, \"rec_size\": %u,"
+					" \"op\": \"%s\", \"ns_per_op\": %.2f,"
+					" \"ee_ops_per_op\": %.3f,"
+					" \"ee_bytes_per_op\": %.3f,"
+					" \"count\": %lu }",
+					sep, g->recs, g->rec_size, op_name[op],
+					r.ns / r.n, (double) r.ops / r.n,
+					(double) r.bytes / r.n, r.n );
+				sep = ",";
+			}
+			else
+				printf( "%5u %8u %-7s %12.1f %12.2f %12.2f %10lu\n",
+					g->recs, g->rec_size, op_name[op],
+					r.ns / r.n, (double) r.ops / r.n,
+					(double) r.bytes / r.n, r.n );
+		}
+	}
+
+	if ( json ) printf( "\n  ],\n  \"ram\": [" );
+	else printf( "\n%5s %8s %6s\n", "recs", "rec_size", "ram" );
+	sep = "";
+	for ( k = 0; k < sizeof cells / sizeof cells[0]; ++k )
+	{
+		ram += rams[k];
+		if ( json )
+			printf( "%s\n    { \"recs\": %u, \"rec_size\": %u,"
+				" \"ram\": %u }", sep, cells[k]->recs,
+				cells[k]->rec_size, rams[k] );
+		else
+			printf( "%5u %8u %6u\n", cells[k]->recs,
+				cells[k]->rec_size, rams[k] );
+		sep = ",";
+	}
+	if ( json )
+		printf( "\n  ],\n  \"ram_total\": %u, \"ram_shared\": %u",
+			ram, (unsigned) LOG_SHARED_RAM );
+	else
+		printf( "all logs: %u bytes of RAM (shared buffer %u)\n",
+			ram, (unsigned) LOG_SHARED_RAM );
+#ifdef BENCH_BLOOM
+	if ( json )
+		printf( ",\n  \"bloom\": { \"bytes\": %d, \"k\": %d,"
+			" \"codes\": %d },\n  \"bloom_results\": [",
+			LOG_BLOOM_BYTES, LOG_BLOOM_K, BENCH_CODES );
+	else
+		printf( "\n%5s %8s %5s %6s %8s %12s %12s %12s\n", "recs",
+			"rec_size", "block", "ram", "fp", "ns/query",
+			"ee ops/q", "ee bytes/q" );
+	sep = "";
+	for ( k = 0; k < sizeof blooms / sizeof blooms[0]; ++k )
+	{
+		const struct Bench_Bloom * f = blooms[k];
+		struct Bloom_Result r;
+		measure_bloom( f, min_ns, &r );
+		if ( json )
+		{
+			printf( "%s\n    { \"recs\": %u, \"rec_size\": %u,"
+				" \"block\": %u, \"ram\": %u, \"fp_rate\": %.4f,"
+				" \"ns_per_query\": %.2f,"
+				" \"ee_ops_per_query\": %.3f,"
+				" \"ee_bytes_per_query\": %.3f }",
+				sep, f->g->recs, f->g->rec_size, f->block,
+				f->ram, r.fp, r.q.ns / r.q.n,
+				(double) r.q.ops / r.q.n,
+				(double) r.q.bytes / r.q.n );
+			sep = ",";
+		}
+		else
+			printf( "%5u %8u %5u %6u %8.4f %12.1f %12.2f %12.2f\n",
+				f->g->recs, f->g->rec_size, f->block, f->ram,
+				r.fp, r.q.ns / r.q.n, (double) r.q.ops / r.q.n,
+				(double) r.q.bytes / r.q.n );
+	}
+	if ( json ) printf( "\n  ]" );
+#endif
+	if ( json ) printf( "\n}\n" );
+	return 0;
+}
+
+
+/* End of file  ee-logs-bench.c */
@@ -0,0 +1,519 @@
+/* ee-logs-decode.c */
+/*
+ Decoder of logs from image of EEPROM
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host):
+	cc -O2 -o ee-logs-decode ee-logs-decode.c
+
+ Usage:
+	ee-logs-decode -n RECS -s REC_SIZE [-a START_ADDR] [-P PAGE]
+			[-d DICT] [-e OFFSET] [-T OFFSET[:WIDTH]] [-x]
+			[-f TMIN] [-t TMAX] [-c CODE] IMAGE
+
+	IMAGE is a binary image of EEPROM; the log is RECS records of
+	REC_SIZE bytes from address START_ADDR (as in LOGGER macro).
+	-P: records are in slots of LOG_PAGE_ALIGN for LOG_PAGE_SIZE
+	PAGE (see ee-logs.h).
+
+	Records are printed from the oldest to the newest one, one
+	line per record: number of record and bytes of record in hex
+	(flag bit is cleared as Log_Read* functions do).
+
+	Byte at OFFSET (-e) of record is index of event.  With -d it is
+	printed as code and name of event from dictionary DICT (see
+	ee-logs-dict.h).  DICT is a text file with line 'CODE NAME' for
+	every event in order of the list of events; empty lines and
+	lines from '#' are skipped.
+
+	-T: record has timestamp of WIDTH bytes (1..4, default 4,
+	little endian) from OFFSET.
+
+	-x: write sidecar index IMAGE.idx (see ee-index.h).
+
+	-f, -t, -c: print only records with timestamp from TMIN to TMAX
+	and with event CODE (code from DICT with -d, else index of
+	event).  If IMAGE.idx is made for the same image and layout,
+	the image is skipped without reading if no record matches,
+	else only records of matched blocks are read.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ee-image.h"
+#include "ee-index.h"
+
+
+#ifndef EE_LOGS_FUZZ
+
+struct Dict {
+	unsigned n;
+	unsigned code[256];
+	char name[256][32];
+};
+
+
+static int
+load_dict( const char * fn, struct Dict * d )
+{
+	char line[256];
+	FILE * f = fopen( fn, "r" );
+	if ( !f ) { perror( fn ); return -1; }
+	d->n = 0;
+	while ( fgets( line, sizeof line, f ) )
+	{
+		char * p = line, * e;
+		unsigned long c;
+		while ( *p == ' ' || *p == '\t' ) ++p;
+		if ( *p == '#' || *p == '\n' || *p == '\r' || !*p ) continue;
+		c = strtoul( p, &e, 0 );
+		if ( e == p || d->n == 256 )
+		{
+			fprintf( stderr, "%s: bad line: %s", fn, line );
+			fclose( f );
+			return -1;
+		}
+		d->code[d->n] = (unsigned) c;
+		d->name[d->n][0] = 0;
+		sscanf( e, " %31s", d->name[d->n] );
+		d->n++;
+	}
+	fclose( f );
+	return 0;
+}
+
+
+static unsigned char *
+load_image( const char * fn, unsigned long * len )
+{
+	unsigned char * p;
+	long n;
+	FILE * f = fopen( fn, "rb" );
+	if ( !f ) { perror( fn ); return 0; }
+	fseek( f, 0, SEEK_END );
+	n = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	p = malloc( n > 0 ? n : 1 );
+	if ( !p || fread( p, 1, n, f ) != (size_t) n )
+	{
+		fprintf( stderr, "%s: can not read image\n", fn );
+		fclose( f );
+		free( p );
+		return 0;
+	}
+	fclose( f );
+	*len = n;
+	return p;
+}
+
+
+static void
+usage( const char * prog )
+{
+	fprintf( stderr, "usage: %s -n RECS -s REC_SIZE [-a START_ADDR]"
+		" [-P PAGE] [-d DICT] [-e OFFSET] [-T OFFSET[:WIDTH]] [-x]"
+		" [-f TMIN] [-t TMAX] [-c CODE] IMAGE\n", prog );
+	exit( 2 );
+}
+
+
+static void
+print_rec( unsigned k, const unsigned char * rec, const struct Log_Index * x,
+		const struct Dict * dict, int use_dict )
+{
+	unsigned i;
+	printf( "%u:", k );
+	for ( i = 0; i < x->g.rec_size; ++i ) printf( " %02x", rec[i] );
+	if ( x->ev_off != LOG_IDX_NONE && use_dict )
+	{
+		unsigned char e = rec[x->ev_off];
+		if ( e < dict->n )
+			printf( "  0x%04x %s", dict->code[e], dict->name[e] );
+		else
+			printf( "  ?%u", e );
+	}
+	printf( "\n" );
+}
+
+
+/* the same image (by size and time) and the same layout of records */
+static int
+same_index( const struct Log_Index * a, const struct Log_Index * b )
+{
+	return a->img_len == b->img_len && a->img_time == b->img_time
+		&& a->g.recs == b->g.recs && a->g.rec_size == b->g.rec_size
+		&& a->g.start == b->g.start && a->g.slot == b->g.slot
+		&& a->ts_off == b->ts_off
+		&& (a->ts_off == LOG_IDX_NONE || a->ts_width == b->ts_width)
+		&& a->ev_off == b->ev_off;
+}
+
+
+int
+main( int argc, char ** argv )
+{
+	static struct Log_Index x, sx;
+	static struct Dict dict;
+	struct Log_IdxQuery q = { 0, 0xFFFFFFFFUL, -1 };
+	struct Log_Geom g = { 0, 0, 0, 0 };
+	struct Log_Ring r;
+	struct stat st;
+	const char * dfn = 0, * fn;
+	char ifn[4096];
+	long evoff = -1, tsoff = -1, code = -1;
+	unsigned tsw = 4, page = 0;
+	int mkidx = 0, query = 0, fd;
+	unsigned char * img = 0, rec[255];
+	unsigned long len;
+	unsigned k;
+	int c;
+
+	while ( (c = getopt( argc, argv, "n:s:a:P:d:e:T:xf:t:c:" )) != -1 )
+	{
+		char * e;
+		switch ( c )
+		{
+		case 'n': g.recs = strtoul( optarg, 0, 0 ); break;
+		case 's': g.rec_size = strtoul( optarg, 0, 0 ); break;
+		case 'a': g.start = strtoul( optarg, 0, 0 ); break;
+		case 'P': page = strtoul( optarg, 0, 0 ); break;
+		case 'd': dfn = optarg; break;
+		case 'e': evoff = strtol( optarg, 0, 0 ); break;
+		case 'T':
+			tsoff = strtol( optarg, &e, 0 );
+			if ( *e == ':' ) tsw = strtoul( e + 1, 0, 0 );
+			break;
+		case 'x': mkidx = 1; break;
+		case 'f': q.tmin = strtoul( optarg, 0, 0 ); query = 1; break;
+		case 't': q.tmax = strtoul( optarg, 0, 0 ); query = 1; break;
+		case 'c': code = strtol( optarg, 0, 0 ); query = 1; break;
+		default: usage( argv[0] );
+		}
+	}
+	if ( optind + 1 != argc || !g.recs || !g.rec_size ) usage( argv[0] );
+	if ( page & (page - 1) || page > 256 ) usage( argv[0] );
+	g.slot = page ? Log_SlotSize( g.rec_size, page ) : g.rec_size;
+	if ( (dfn || code >= 0) && evoff < 0 ) usage( argv[0] );
+	if ( (q.tmin || q.tmax != 0xFFFFFFFFUL) && tsoff < 0 ) usage( argv[0] );
+	if ( evoff >= (long) g.rec_size
+		|| (tsoff >= 0 && (tsw < 1 || tsw > 4 || tsoff + tsw > g.rec_size)) )
+	{
+		fprintf( stderr, "OFFSET is out of record\n" );
+		return 2;
+	}
+	if ( dfn && load_dict( dfn, &dict ) ) return 1;
+	if ( code >= 0 )
+	{ /* event to index */
+		if ( dfn )
+		{
+			for ( k = 0; k < dict.n && dict.code[k] != (unsigned) code; ++k ) ;
+			q.ev = k < dict.n ? (int) k : 256;
+		}
+		else
+			q.ev = code;
+		if ( q.ev > 255 ) return 0;	/* no such event */
+	}
+
+	fn = argv[optind];
+	if ( stat( fn, &st ) ) { perror( fn ); return 1; }
+	snprintf( ifn, sizeof ifn, "%s.idx", fn );
+
+	/* the wanted layout */
+	x.img_len = st.st_size;
+	x.img_time = (unsigned long) st.st_mtime;
+	x.g = g;
+	x.ts_off = tsoff < 0 ? LOG_IDX_NONE : (unsigned) tsoff;
+	x.ts_width = tsw;
+	x.ev_off = evoff < 0 ? LOG_IDX_NONE : (unsigned) evoff;
+
+	if ( query && !mkidx && Log_IdxLoad( ifn, &sx ) == 0
+		&& same_index( &x, &sx ) )
+	{ /* query by sidecar index */
+		if ( !Log_IdxMayMatch( &sx, &sx.all, &q ) ) return 0;
+		fd = open( fn, O_RDONLY );
+		if ( fd < 0 ) { perror( fn ); return 1; }
+		for ( k = 0; k < sx.count; ++k )
+		{
+			if ( k % LOG_IDX_BLOCK == 0
+				&& !Log_IdxMayMatch( &sx, &sx.blk[k / LOG_IDX_BLOCK], &q ) )
+			{
+				k += LOG_IDX_BLOCK - 1;
+				continue;
+			}
+			if ( pread( fd, rec, g.rec_size, sx.addr[k] ) != (ssize_t) g.rec_size )
+			{
+				fprintf( stderr, "%s: can not read image\n", fn );
+				return 1;
+			}
+			rec[g.rec_size - 1] &= (unsigned char)~LOG_FLAG_MASK;
+			if ( Log_IdxMatch( &sx, rec, &q ) )
+				print_rec( k, rec, &sx, &dict, dfn != 0 );
+		}
+		close( fd );
+		return 0;
+	}
+
+	img = load_image( fn, &len );
+	if ( !img ) return 1;
+	if ( Log_RingInit( &r, img, len, &g ) )
+	{
+		fprintf( stderr, "%s: bad geometry or log is out of image\n", fn );
+		return 1;
+	}
+	Log_IdxBuild( &x, &r, x.ts_off, x.ts_width, x.ev_off );
+	x.img_time = (unsigned long) st.st_mtime;
+	if ( mkidx && Log_IdxSave( ifn, &x ) )
+	{
+		fprintf( stderr, "%s: can not write index\n", ifn );
+		return 1;
+	}
+
+	for ( k = 0; k < Log_RingCount( &r ); ++k )
+	{
+		Log_RingCopy( &r, k, rec );
+		if ( Log_IdxMatch( &x, rec, &q ) )
+			print_rec( k, rec, &x, &dict, dfn != 0 );
+	}
+	free( img );
+	return 0;
+}
+
+
+#else /* EE_LOGS_FUZZ */
+
+/*
+ Fuzzing of the image parser and the sidecar index parser.
+
+ Build with libFuzzer:
+	clang -g -O1 -fsanitize=fuzzer,address -DEE_LOGS_FUZZ		\
+		-o ee-logs-decode-fuzz ee-logs-decode.c
+	ee-logs-decode-fuzz [CORPUS_DIR]
+
+ Build without libFuzzer (random mutations, exec/s is printed):
+	cc -O2 -fsanitize=address,undefined -DEE_LOGS_FUZZ		\
+		-DEE_LOGS_FUZZ_MAIN -o ee-logs-decode-fuzz ee-logs-decode.c
+	ee-logs-decode-fuzz [RUNS [SEED]]
+
+	Byte 0 of input selects target:
+	even -- ring reconstruction: byte 1 is RECS, byte 2 is REC_SIZE,
+		bytes 3, 4 are START_ADDR, the rest is image;
+	odd -- parser of sidecar index: the rest is file of index.
+
+	Results are checked against invariants (the 'free' record is
+	found by the same rule as Log_Init does, records and layout are
+	inside image and record, every record is in summaries of index
+	built for the ring); abort() on violation.  Nothing is
+	allocated while an input is checked.
+*/
+
+static volatile unsigned long fuzz_sink;
+
+static void
+fuzz_ring( const unsigned char * d, size_t n )
+{
+	static struct Log_Index x;
+	struct Log_Geom g;
+	struct Log_Ring r;
+	unsigned char rec[255], f, fk;
+	unsigned k;
+	int fit;
+
+	if ( n < 5 ) return;
+	g.recs = d[1];
+	g.rec_size = d[2];
+	g.start = d[3] | (unsigned) d[4] << 8;
+	g.slot = 0;
+	d += 5;
+	n -= 5;
+	fit = g.recs >= 2 && g.rec_size >= 2
+		&& g.start + (unsigned long) g.recs * g.rec_size <= n;
+	if ( Log_RingInit( &r, d, n, &g ) )
+	{
+		if ( fit ) abort();		/* good geometry is rejected */
+		return;
+	}
+	if ( !fit || r.cur >= g.recs ) abort();
+
+	f = d[g.start + g.rec_size - 1] & LOG_FLAG_MASK;
+	for ( k = 1; k < g.recs; ++k )
+	{
+		fk = d[g.start + (k + 1) * g.rec_size - 1] & LOG_FLAG_MASK;
+		if ( r.cur == 0 ? fk != f : (k < r.cur ? fk != f : k == r.cur && fk == f) )
+			abort();
+	}
+	fit = g.rec_size >= 5;		/* timestamp 0..3, event 4 */
+	if ( fit && Log_IdxBuild( &x, &r, 0, 4, 4 ) ) abort();
+	for ( k = 0; k < Log_RingCount( &r ); ++k )
+	{
+		const unsigned char * p = Log_RingRec( &r, k );
+		if ( Log_RingSlot( &r, k ) == r.cur
+			|| p < d + g.start || p + g.rec_size > d + n )
+			abort();
+		Log_RingCopy( &r, k, rec );
+		if ( rec[g.rec_size - 1] & LOG_FLAG_MASK ) abort();
+		if ( fit )
+		{ /* record is in summaries of index */
+			const struct Log_IdxSum * b = &x.blk[k / LOG_IDX_BLOCK];
+			unsigned long t = Log_IdxTs( &x, rec );
+			if ( x.addr[k] != (unsigned long)(p - d)
+				|| t < b->tmin || t > b->tmax
+				|| t < x.all.tmin || t > x.all.tmax
+				|| !(b->ev[rec[4] >> 3] & (1u << (rec[4] & 7)))
+				|| !(x.all.ev[rec[4] >> 3] & (1u << (rec[4] & 7))) )
+				abort();
+		}
+		fuzz_sink += rec[0];
+	}
+}
+
+static void
+fuzz_index( const unsigned char * d, size_t n )
+{
+	static struct Log_Index x;
+	static const unsigned char zero[255];
+	struct Log_IdxQuery q = { 100, 1000, 5 };
+	unsigned k;
+
+	if ( Log_IdxParse( &x, d + 1, n - 1 ) ) return;
+	if ( (x.ts_off != LOG_IDX_NONE && x.ts_off + x.ts_width > x.g.rec_size)
+		|| (x.ev_off != LOG_IDX_NONE && x.ev_off >= x.g.rec_size)
+		|| x.count >= x.g.recs )
+		abort();
+	for ( k = 0; k < x.count; ++k )
+		if ( x.addr[k] + x.g.rec_size > x.img_len ) abort();
+	fuzz_sink += Log_IdxMayMatch( &x, &x.all, &q );
+	for ( k = 0; k < (x.count + LOG_IDX_BLOCK - 1) / LOG_IDX_BLOCK; ++k )
+		fuzz_sink += Log_IdxMayMatch( &x, &x.blk[k], &q );
+	fuzz_sink += Log_IdxMatch( &x, zero, &q ) + Log_IdxTs( &x, zero );
+}
+
+int
+LLVMFuzzerTestOneInput( const unsigned char * d, size_t n )
+{
+	if ( n == 0 ) return 0;
+	if ( d[0] & 1 ) fuzz_index( d, n );
+	else fuzz_ring( d, n );
+	return 0;
+}
+
+
+#ifdef EE_LOGS_FUZZ_MAIN
+
+#include <sys/time.h>
+
+static double
+fuzz_now( void )
+{
+	struct timeval tv;
+	gettimeofday( &tv, 0 );
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/* a right index of random image (it is mutated by fuzz loop) */
+static size_t
+fuzz_seed_index( unsigned char * buf, size_t max )
+{
+	static unsigned char img[4096];
+	static struct Log_Index x;
+	struct Log_Geom g = { 100, 9, 13, 0 };
+	struct Log_Ring r;
+	char fn[] = "/tmp/ee-fuzz-XXXXXX";
+	size_t n = 0;
+	FILE * f;
+	int fd = mkstemp( fn );
+	unsigned k;
+
+	for ( k = 0; k < sizeof img; ++k ) img[k] = (unsigned char) rand();
+	Log_RingInit( &r, img, sizeof img, &g );
+	Log_IdxBuild( &x, &r, 0, 4, 4 );
+	if ( fd >= 0 )
+	{
+		close( fd );
+		if ( !Log_IdxSave( fn, &x ) && (f = fopen( fn, "rb" )) )
+		{
+			n = fread( buf + 1, 1, max - 1, f ) + 1;
+			fclose( f );
+			if ( Log_IdxLoad( fn, &x ) ) abort();	/* right index */
+		}
+		unlink( fn );
+	}
+	buf[0] = 1;
+	return n;
+}
+
+int
+main( int argc, char ** argv )
+{
+	static unsigned char in[4096], seed[4096];
+	unsigned long runs = argc > 1 ? strtoul( argv[1], 0, 0 ) : 1000000;
+	unsigned long i, next = 1024;
+	size_t n, sn;
+	double t0;
+	unsigned k;
+
+	srand( argc > 2 ? strtoul( argv[2], 0, 0 ) : 1 );
+	sn = fuzz_seed_index( seed, sizeof seed );
+	t0 = fuzz_now();
+	for ( i = 1; i <= runs; ++i )
+	{
+		if ( (i & 1) && sn )
+		{ /* mutated right index */
+			n = sn;
+			memcpy( in, seed, n );
+			if ( rand() % 8 == 0 ) n = rand() % (sn + 1);
+			for ( k = rand() % 4 + 1; k--; )
+				in[1 + rand() % (sn - 1)] ^= (unsigned char)(1u << rand() % 8);
+		}
+		else
+		{ /* random ring: geometry is often right */
+			n = 5 + rand() % (sizeof in - 5);
+			for ( k = 0; k < n; ++k ) in[k] = (unsigned char) rand();
+			in[0] &= 0xFE;
+			if ( rand() % 2 )
+			{
+				in[1] = 2 + rand() % 60;
+				in[2] = 2 + rand() % 60;
+				in[3] = rand() % 64;
+				in[4] = 0;
+			}
+		}
+		LLVMFuzzerTestOneInput( in, n );
+		if ( i == next || i == runs )
+		{
+			double dt = fuzz_now() - t0;
+			printf( "#%lu\texec/s: %.0f\n", i, dt > 0 ? i / dt : 0.0 );
+			fflush( stdout );
+			next *= 2;
+		}
+	}
+	return 0;
+}
+
+#endif /* EE_LOGS_FUZZ_MAIN */
+
+#endif /* EE_LOGS_FUZZ */
+
+
+/* End of file  ee-logs-decode.c */
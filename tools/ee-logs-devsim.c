@@ -0,0 +1,235 @@
+/* ee-logs-devsim.c */
+/*
+ Device stand-in for export of logs over UART (see ee-logs-export.h)
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host), geometry of log is set at compile time:
+	cc -O2 -DRECS=100 -DREC_SIZE=8 -DSTART_ADDR=0			\
+		-DPER_FRAME=16 -DWINDOW=4 -I.. -o ee-logs-devsim ee-logs-devsim.c
+
+ Usage:
+	ee-logs-devsim [-l LOSS] [-r SEED] [-t MS] IMAGE
+
+	Runs Log_Init and LOG_EXPORT of ee-logs.h and ee-logs-export.h
+	with EEPROM from IMAGE and UART on master of pseudo-terminal.
+	Name of slave of pseudo-terminal is printed to stdout; run
+	ee-logs-recv on it.  Export starts by the first byte from
+	receiver.
+
+	LOSS is probability (in 1/1000) to lose a transmitted byte;
+	Log_ExportTimeout is called if nothing is received for MS
+	milliseconds (default 200).
+*/
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#ifndef RECS
+#define RECS		100
+#endif
+#ifndef REC_SIZE
+#define REC_SIZE	8
+#endif
+#ifndef START_ADDR
+#define START_ADDR	0
+#endif
+#ifndef PER_FRAME
+#define PER_FRAME	16
+#endif
+#ifndef WINDOW
+#define WINDOW		4
+#endif
+
+
+static unsigned char * img;
+static unsigned long img_len;
+static int pty;
+static long loss;
+
+static unsigned char txb[64];
+static unsigned txn;
+static unsigned char rxb[256];
+static unsigned rxn, rxi;
+static double last_rx;			/* time of the last received byte */
+static int retry;			/* timeouts without answer */
+
+
+static double
+now( void )
+{
+	struct timeval tv;
+	gettimeofday( &tv, 0 );
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+unsigned char ReadEE( void * a ) { return img[(unsigned long) a]; }
+unsigned char isEEfree( void ) { return 1; }
+void WriteEE( void * a, unsigned char b ) { (void) a; (void) b; }
+
+static void
+flush_tx( void )
+{
+	ssize_t n = write( pty, txb, txn );
+	if ( n > 0 )
+	{
+		memmove( txb, txb + n, txn - n );
+		txn -= n;
+	}
+}
+
+unsigned char
+isUARTfree( void )
+{
+	if ( txn == sizeof txb ) flush_tx();
+	return txn < sizeof txb;
+}
+
+void
+WriteUART( unsigned char b )
+{
+	if ( loss && rand() % 1000 < loss ) return;
+	txb[txn++] = b;
+}
+
+unsigned char
+isUARTdata( void )
+{
+	ssize_t n;
+	if ( rxi < rxn ) return 1;
+	n = read( pty, rxb, sizeof rxb );
+	rxi = 0;
+	rxn = n > 0 ? n : 0;
+	if ( rxn ) last_rx = now(), retry = 0;
+	return rxn != 0;
+}
+
+unsigned char ReadUART( void ) { return rxb[rxi++]; }
+
+
+#include "ee-logs.h"
+#include "ee-logs-export.h"
+
+DECLARE_LOGGER( Dev, RECS, REC_SIZE, START_ADDR )
+DECLARE_LOG_EXPORT( Dev )
+LOGGER( Dev, RECS, REC_SIZE, START_ADDR )
+LOG_EXPORT( Dev, RECS, REC_SIZE, START_ADDR, PER_FRAME, WINDOW )
+
+
+static void
+usage( const char * prog )
+{
+	fprintf( stderr, "usage: %s [-l LOSS] [-r SEED] [-t MS] IMAGE\n", prog );
+	exit( 2 );
+}
+
+
+int
+main( int argc, char ** argv )
+{
+	struct termios t;
+	FILE * f;
+	long tmo = 200;
+	int c, sl;
+
+	while ( (c = getopt( argc, argv, "l:r:t:" )) != -1 )
+	{
+		switch ( c )
+		{
+		case 'l': loss = strtol( optarg, 0, 0 ); break;
+		case 'r': srand( strtoul( optarg, 0, 0 ) ); break;
+		case 't': tmo = strtol( optarg, 0, 0 ); break;
+		default: usage( argv[0] );
+		}
+	}
+	if ( optind + 1 != argc ) usage( argv[0] );
+
+	f = fopen( argv[optind], "rb" );
+	if ( !f ) { perror( argv[optind] ); return 1; }
+	fseek( f, 0, SEEK_END );
+	img_len = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	if ( img_len < START_ADDR + (unsigned long) RECS * REC_SIZE )
+	{
+		fprintf( stderr, "%s: log is out of image\n", argv[optind] );
+		return 1;
+	}
+	img = malloc( img_len );
+	if ( !img || fread( img, 1, img_len, f ) != img_len )
+	{
+		fprintf( stderr, "%s: can not read image\n", argv[optind] );
+		return 1;
+	}
+	fclose( f );
+
+	pty = posix_openpt( O_RDWR | O_NOCTTY );
+	if ( pty < 0 || grantpt( pty ) || unlockpt( pty ) )
+	{
+		perror( "pseudo-terminal" );
+		return 1;
+	}
+	/* raw mode of slave before receiver opens it (no echo) */
+	sl = open( ptsname( pty ), O_RDWR | O_NOCTTY );
+	if ( sl >= 0 && tcgetattr( sl, &t ) == 0 )
+	{
+		cfmakeraw( &t );
+		tcsetattr( sl, TCSANOW, &t );
+	}
+	printf( "%s\n", ptsname( pty ) );
+	fflush( stdout );
+
+	Log_Init( Dev );
+	while ( !isUARTdata() ) usleep( 1000 );
+	fcntl( pty, F_SETFL, fcntl( pty, F_GETFL ) | O_NONBLOCK );
+	rxi = rxn;			/* the first byte starts export */
+	Log_ExportStart( Dev );
+
+	while ( !Log_ExportPoll( Dev ) || txn )
+	{
+		flush_tx();
+		if ( now() - last_rx > tmo / 1000.0 )
+		{ /* no answer */
+			if ( ++retry == 100 )
+			{
+				fprintf( stderr, "no answer from receiver\n" );
+				return 1;
+			}
+			Log_ExportTimeout( Dev );
+			last_rx = now();
+		}
+		if ( txn == sizeof txb ) usleep( 100 );
+	}
+	tcdrain( pty );
+	usleep( 100000 );
+	if ( sl >= 0 ) close( sl );
+	close( pty );
+	return 0;
+}
+
+
+/* End of file  ee-logs-devsim.c */
@@ -0,0 +1,275 @@
+/* ee-logs-diff.c */
+/*
+ Differential test and benchmark of two engines of logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host), the reference engine and the new engine (see
+ ee-logs-engine.c) with the same geometry of log:
+	cc -O2 -c -DENGINE=Log_EngRef -DENGINE_REF -o ref.o ee-logs-engine.c
+	cc -O2 -c -DENGINE=Log_EngNew -DLOG_PAGE_SIZE=16 -DLOG_BURST_READ\
+		-DENGINE_QLEN=8 -o new.o ee-logs-engine.c
+	cc -O2 -o ee-logs-diff ee-logs-diff.c ref.o new.o
+
+	(names of engines may be changed by -DREF=NAME -DNEW=NAME)
+
+ Usage:
+	ee-logs-diff [-n OPS] [-r SEED] [-l]
+
+	Both engines start from the same random contents of EEPROM and
+	get the same random sequence of OPS operations (default 100000):
+	append, sync (end of all writing), init, read first, last, next,
+	previous and current record.  Engine is synced before every read
+	and init.  Results of reads and contents of EEPROM (after every
+	sync) must be the same, else the first difference is printed
+	and exit status is 1.
+
+	Log_Init of the original ee-logs.h (the default reference
+	engine) takes bit 7 of the first byte of record K+1 (of the
+	byte after the ring for the last record) as the flag of record
+	K; ee-logs.h takes it from the last byte of record K.  So before
+	every init the flag of every record is copied to that byte (in
+	both EEPROMs, so both engines read the same data), and both
+	versions must find the same free slot.  With -l nothing is
+	copied: so Log_Init is tested on random contents of EEPROM
+	too, if the reference engine reads flags from the last bytes
+	(see LOGS_H of ee-logs-engine.c); the original ee-logs.h
+	differs at the first init.
+
+	For every operation number of calls, time (ns/op, with overhead
+	of clock) and EEPROM transactions (per call) of both engines
+	and speedup of the new engine are printed.
+
+	Cost of LOG_VERIFY of ee-logs.h (and that it repairs lost
+	writes) is measured by the same engine with the option and
+	with failing EEPROM as the new engine:
+	cc -O2 -c -DENGINE=Log_EngNew -DLOG_VERIFY -DEE_SIM_FAIL=50	\
+		-o new.o ee-logs-engine.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ee-sim.h"
+
+#ifndef REF
+#define REF	Log_EngRef
+#endif
+#ifndef NEW
+#define NEW	Log_EngNew
+#endif
+
+extern const struct Log_Engine REF, NEW;
+
+
+enum { OP_APPEND, OP_SYNC, OP_INIT, OP_FIRST, OP_LAST, OP_NEXT, OP_PREV,
+	OP_CUR, NOPS };
+
+static const char * op_name[NOPS] = {
+	"append", "sync", "init", "first", "last", "next", "prev", "cur"
+};
+
+struct Op_Stat {
+	unsigned long calls;
+	double ns[2];
+	unsigned long ee[2];		/* EEPROM transactions */
+};
+
+static struct Op_Stat st[NOPS];
+static const struct Log_Engine * eng[2] = { &REF, &NEW };
+
+
+static double
+now_ns( void )
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/* do operation op by engine e; return result of read */
+static unsigned char
+run( int e, int op, const unsigned char * src, unsigned char * dst )
+{
+	const struct Log_Engine * g = eng[e];
+	unsigned long o = Ee_SimOps( g->stat );
+	unsigned char r = 1;
+	double t = now_ns();
+	switch ( op )
+	{
+	case OP_APPEND: g->append( src ); break;
+	case OP_SYNC: g->sync(); break;
+	case OP_INIT: g->init(); break;
+	case OP_FIRST: g->first( dst ); break;
+	case OP_LAST: g->last( dst ); break;
+	case OP_NEXT: r = g->next( dst ); break;
+	case OP_PREV: r = g->prev( dst ); break;
+	default: g->cur( dst ); break;
+	}
+	st[op].ns[e] += now_ns() - t;
+	st[op].ee[e] += Ee_SimOps( g->stat ) - o;
+	return r;
+}
+
+/* copy flags of records to bytes read by Log_Init of the original
+   ee-logs.h (see -l) */
+static void
+orig_flags( void )
+{
+	unsigned long a = REF.start;
+	unsigned k;
+	for ( k = 0; k < REF.recs; ++k )
+	{
+		a += REF.rec_size;
+		REF.mem[a] = NEW.mem[a] = (unsigned char)( (REF.mem[a] & 0x7F)
+			| (REF.mem[a - 1] & 0x80) );
+	}
+}
+
+static int
+same_mem( unsigned long n )
+{
+	unsigned long k;
+	for ( k = 0; k < n; ++k )
+		if ( REF.mem[k] != NEW.mem[k] )
+		{
+			printf( "EEPROM differs at address %lu: %02x %02x\n",
+				k, REF.mem[k], NEW.mem[k] );
+			return 0;
+		}
+	return 1;
+}
+
+
+int
+main( int argc, char ** argv )
+{
+	unsigned char src[255], d0[255], d1[255];
+	unsigned long ops = 100000, i, n, seq = 0;
+	unsigned k;
+	int op = OP_SYNC, c, dirty = 0, last = 0;
+
+	while ( (c = getopt( argc, argv, "n:r:l" )) != -1 )
+	{
+		switch ( c )
+		{
+		case 'n': ops = strtoul( optarg, 0, 0 ); break;
+		case 'r': srand( strtoul( optarg, 0, 0 ) ); break;
+		case 'l': last = 1; break;
+		default:
+			fprintf( stderr, "usage: %s [-n OPS] [-r SEED] [-l]\n",
+				argv[0] );
+			return 2;
+		}
+	}
+	if ( REF.recs != NEW.recs || REF.rec_size != NEW.rec_size
+		|| REF.start != NEW.start )
+	{
+		fprintf( stderr, "engines have different geometry of log\n" );
+		return 2;
+	}
+	n = REF.mem_size < NEW.mem_size ? REF.mem_size : NEW.mem_size;
+	if ( n <= REF.start + (unsigned long) REF.recs * REF.rec_size )
+	{
+		fprintf( stderr, "log does not fit into EEPROM\n" );
+		return 2;
+	}
+	for ( i = 0; i < n; ++i ) REF.mem[i] = NEW.mem[i] = (unsigned char) rand();
+	if ( !last ) orig_flags();
+	run( 0, OP_INIT, 0, 0 );
+	run( 1, OP_INIT, 0, 0 );
+	st[OP_INIT].calls++;
+
+	for ( i = 0; i < ops; ++i )
+	{
+		unsigned char r0, r1;
+		c = rand() % 100;
+		op = c < 45 ? OP_APPEND : c < 50 ? OP_SYNC : c < 52 ? OP_INIT
+			: OP_FIRST + (c - 52) % (NOPS - OP_FIRST);
+		if ( op == OP_APPEND )
+		{
+			for ( k = 0; k < REF.rec_size; ++k ) src[k] = (unsigned char) rand();
+			src[0] = (unsigned char) seq++;
+			dirty = 1;
+		}
+		else if ( dirty )
+		{ /* end writing before reads */
+			run( 0, OP_SYNC, 0, 0 );
+			run( 1, OP_SYNC, 0, 0 );
+			st[OP_SYNC].calls++;
+			dirty = 0;
+			if ( !same_mem( n ) ) goto fail;
+		}
+		if ( op == OP_INIT && !last ) orig_flags();
+		memset( d0, 0, sizeof d0 );
+		memset( d1, 0, sizeof d1 );
+		r0 = run( 0, op, src, d0 );
+		r1 = run( 1, op, src, d1 );
+		st[op].calls++;
+		if ( !r0 != !r1 || memcmp( d0, d1, REF.rec_size ) )
+		{
+			printf( "results differ: %d %d\n", r0, r1 );
+			for ( k = 0; k < REF.rec_size; ++k ) printf( " %02x", d0[k] );
+			printf( "\n" );
+			for ( k = 0; k < REF.rec_size; ++k ) printf( " %02x", d1[k] );
+			printf( "\n" );
+			goto fail;
+		}
+		if ( op == OP_SYNC && !same_mem( n ) ) goto fail;
+	}
+	run( 0, OP_SYNC, 0, 0 );
+	run( 1, OP_SYNC, 0, 0 );
+	st[OP_SYNC].calls++;
+	if ( !same_mem( n ) ) goto fail;
+
+	printf( "%s vs %s: %lu operations, the same results\n\n",
+		REF.name, NEW.name, ops );
+	printf( "%-8s %9s %10s %10s %8s %10s %10s %8s\n", "op", "calls",
+		"ref ns/op", "new ns/op", "speedup", "ref ee/op", "new ee/op",
+		"ee ratio" );
+	for ( k = 0; k < NOPS; ++k )
+	{
+		const struct Op_Stat * s = &st[k];
+		double c1 = s->calls ? s->calls : 1;
+		printf( "%-8s %9lu %10.1f %10.1f %8.2f %10.2f %10.2f %8.2f\n",
+			op_name[k], s->calls, s->ns[0] / c1, s->ns[1] / c1,
+			s->ns[1] > 0 ? s->ns[0] / s->ns[1] : 0.0,
+			s->ee[0] / c1, s->ee[1] / c1,
+			s->ee[1] ? (double) s->ee[0] / s->ee[1] : 0.0 );
+	}
+	printf( "\nEEPROM: ref %lu reads, %lu block reads, %lu writes,"
+		" %lu page writes, %lu polls\n", REF.stat->reads,
+		REF.stat->block_reads, REF.stat->writes, REF.stat->page_writes,
+		REF.stat->polls );
+	printf( "        new %lu reads, %lu block reads, %lu writes,"
+		" %lu page writes, %lu polls\n", NEW.stat->reads,
+		NEW.stat->block_reads, NEW.stat->writes, NEW.stat->page_writes,
+		NEW.stat->polls );
+	return 0;
+
+fail:
+	printf( "engines differ after operation %lu (%s)\n", i, op_name[op] );
+	return 1;
+}
+
+
+/* End of file  ee-logs-diff.c */
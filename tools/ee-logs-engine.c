@@ -0,0 +1,152 @@
+/* ee-logs-engine.c */
+/*
+ One engine of logger on simulated EEPROM (see ee-sim.h)
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host) one object file for every engine:
+	cc -O2 -c -DENGINE=NAME [-DENGINE_REF] [-DLOGS_H='"FILE"']
+		[-DENGINE_QLEN=QLEN] [-DRECS=..] [-DREC_SIZE=..]
+		[-DSTART_ADDR=..] [options of ee-logs.h]
+		-o NAME.o ee-logs-engine.c
+
+	Defines 'const struct Log_Engine NAME'.
+
+	LOGS_H is the logger: default is "ee-logs-orig.h" (the original
+	ee-logs.h, without options) for the reference engine (if
+	ENGINE_REF is defined) and "../ee-logs.h" else; one can use a
+	copy of other version of ee-logs.h (for example, from git
+	history) as reference engine.
+
+	Records are appended by Log_NoblockingWrite, or by Log_Append
+	and Log_Flush if ENGINE_QLEN is defined.
+
+	Options of ee-logs.h (LOG_PAGE_SIZE, LOG_BURST_READ, ...) and
+	EE_SIM_SIZE, EE_SIM_BUSY, EE_SIM_FAIL of ee-sim.h are set by -D.
+*/
+
+#define EE_SIM_DEVICE
+#include "ee-sim.h"
+
+#ifndef LOGS_H
+#ifdef ENGINE_REF
+#define LOGS_H	"ee-logs-orig.h"
+#else
+#define LOGS_H	"../ee-logs.h"
+#endif
+#endif
+#include LOGS_H
+
+#ifndef ENGINE
+#error "ENGINE (name of engine) must be defined"
+#endif
+#ifndef RECS
+#define RECS		50
+#endif
+#ifndef REC_SIZE
+#define REC_SIZE	7
+#endif
+#ifndef START_ADDR
+#define START_ADDR	13
+#endif
+
+#define Eng_Str__( x )	#x
+#define Eng_Str( x )	Eng_Str__( x )
+
+/* ENGINE is the name of log too (names are unique in program) */
+#define Eng_Expand( m, ... )	m( __VA_ARGS__ )
+
+
+Eng_Expand( DECLARE_LOGGER, ENGINE, RECS, REC_SIZE, START_ADDR )
+Eng_Expand( LOGGER, ENGINE, RECS, REC_SIZE, START_ADDR )
+
+#ifdef ENGINE_QLEN
+Eng_Expand( DECLARE_LOG_QUEUE, ENGINE )
+Eng_Expand( LOG_QUEUE, ENGINE, RECS, REC_SIZE, START_ADDR, ENGINE_QLEN )
+#endif
+
+
+static void
+Eng_Init( void )
+{
+	Eng_Expand( Log_Init, ENGINE );
+}
+
+static void
+Eng_Append( const unsigned char * src )
+{
+#ifdef ENGINE_QLEN
+	while ( !Eng_Expand( Log_Append, ENGINE, src ) )
+		Eng_Expand( Log_Flush, ENGINE );
+#else
+	while ( !Eng_Expand( Log_NoblockingWrite, ENGINE, src ) ) ;
+#endif
+}
+
+static void
+Eng_Sync( void )
+{
+#ifdef ENGINE_QLEN
+	while ( !Eng_Expand( Log_Flush, ENGINE ) ) ;
+#else
+	while ( !Eng_Expand( Log_NoblockingWrite, ENGINE, 0 ) ) ;
+#endif
+}
+
+static void
+Eng_First( unsigned char * dst )
+{
+	Eng_Expand( Log_ReadFirst, ENGINE, dst );
+}
+
+static void
+Eng_Last( unsigned char * dst )
+{
+	Eng_Expand( Log_ReadLast, ENGINE, dst );
+}
+
+static unsigned char
+Eng_Next( unsigned char * dst )
+{
+	return Eng_Expand( Log_ReadNext, ENGINE, dst );
+}
+
+static unsigned char
+Eng_Prev( unsigned char * dst )
+{
+	return Eng_Expand( Log_ReadPrev, ENGINE, dst );
+}
+
+static void
+Eng_Cur( unsigned char * dst )
+{
+	Eng_Expand( Log_ReadCur, ENGINE, dst );
+}
+
+
+const struct Log_Engine ENGINE = {
+	Eng_Str( ENGINE ),
+	RECS, REC_SIZE, START_ADDR,
+	Ee_Mem, sizeof Ee_Mem, &Ee_Stat,
+	Eng_Init, Eng_Append, Eng_Sync,
+	Eng_First, Eng_Last, Eng_Next, Eng_Prev, Eng_Cur
+};
+
+
+/* End of file  ee-logs-engine.c */
@@ -0,0 +1,189 @@
+/* ee-logs-lzbench.c */
+/*
+ Compression ratio and speed of ee-logs-lz.h on samples of records
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host):
+	cc -O2 -I.. -o ee-logs-lzbench ee-logs-lzbench.c
+	cc -O2 -I.. -DLOG_LZ_WINDOW=32 -o ee-logs-lzbench32 ee-logs-lzbench.c
+
+ Usage:
+	ee-logs-lzbench USIZE GROUP REC_SIZE [FILE]
+
+	FILE is a binary file of records of user (USIZE bytes each);
+	without FILE synthetic telemetry records are used.
+
+	At the end prints compression ratio (bytes of user / bytes of
+	log records with all service bytes), number of records of log
+	per block, calls of Log_LzFlush which make them (LOG_LZ_STEP
+	compares by a call) and time of encoding and decoding per byte of user
+	data.  Every block is decoded and compared with source.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ee-logs-lz.h"
+
+
+static double
+now( void )
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+
+static unsigned char *
+load( const char * fn, unsigned usize, unsigned long * nrec )
+{
+	unsigned char * p;
+	unsigned long n, i;
+	FILE * f;
+
+	if ( !fn )
+	{ /* timestamp, event code from small set, slowly changing ADC */
+		n = 20000;
+		p = malloc( n * usize );
+		if ( !p ) return 0;
+		memset( p, 0, n * usize );
+		for ( i = 0; i < n; ++i )
+		{
+			unsigned char * r = p + i * usize;
+			unsigned long ts = 1000 + i * 10 + (rand() & 3);
+			unsigned adc = 512 + (rand() % 9) - 4;
+			r[0] = (unsigned char) ts;
+			if ( usize > 1 ) r[1] = (unsigned char)(ts >> 8);
+			if ( usize > 3 ) r[3] = (unsigned char)(rand() % 4 + 1);
+			if ( usize > 5 ) { r[4] = (unsigned char) adc; r[5] = adc >> 8; }
+		}
+		*nrec = n;
+		return p;
+	}
+
+	f = fopen( fn, "rb" );
+	if ( !f ) { perror( fn ); return 0; }
+	fseek( f, 0, SEEK_END );
+	n = ftell( f ) / usize;
+	fseek( f, 0, SEEK_SET );
+	p = malloc( n * usize + 1 );
+	if ( !p || fread( p, usize, n, f ) != n ) { fclose( f ); return 0; }
+	fclose( f );
+	*nrec = n;
+	return p;
+}
+
+
+int
+main( int argc, char ** argv )
+{
+	unsigned usize, group, rsize;
+	unsigned long nrec, b, nblk, logrecs = 0, calls = 0;
+	unsigned char * data, * out, * chunk;
+	double tenc = 0, tdec = 0, t;
+
+	if ( argc < 4 )
+	{
+		fprintf( stderr, "usage: %s USIZE GROUP REC_SIZE [FILE]\n",
+			argv[0] );
+		return 2;
+	}
+	usize = atoi( argv[1] );
+	group = atoi( argv[2] );
+	rsize = atoi( argv[3] );
+	if ( !usize || !group || group > 255 || rsize < 3 || rsize > 255
+		|| usize * group > 65535 )
+	{
+		fprintf( stderr, "bad USIZE, GROUP or REC_SIZE\n" );
+		return 2;
+	}
+
+	data = load( argc > 4 ? argv[4] : 0, usize, &nrec );
+	if ( !data ) return 1;
+	nblk = nrec / group;
+	if ( !nblk ) { fprintf( stderr, "too few records\n" ); return 1; }
+
+	out = malloc( usize * group );
+	chunk = malloc( (nrec * usize * 9 / 8 / (rsize - 1) + 2 * nblk)
+			* (rsize - 1) );
+	if ( !out || !chunk ) return 1;
+
+	for ( b = 0; b < nblk; ++b )
+	{
+		const unsigned char * blk = data + b * usize * group;
+		struct Log_LzEnc z;
+		struct Log_LzDec d;
+		unsigned long n = 0, k, c;
+		unsigned char r = 0;
+
+		/* the same cutting to records of log as Log_LzFlush does */
+		t = now();
+		Log_LzEncInit( &z, blk, usize * group );
+		chunk[n++] = (unsigned char) group;
+		k = 1;				/* bytes of record of log */
+		for ( ;; )
+		{
+			c = Log_LzEncode( &z, chunk + n, rsize - 1 - k );
+			n += c;
+			k += c;
+			calls++;
+			if ( k < rsize - 1 && !Log_LzEncDone( &z ) ) continue;
+			logrecs++;
+			if ( Log_LzEncDone( &z ) ) break;
+			k = 0;
+		}
+		tenc += now() - t;
+
+		t = now();
+		Log_LzDecInit( &d, out, usize * group );
+		for ( k = 1; k < n && !r; k += rsize - 1 )
+			r = Log_LzDecode( &d, chunk + k,
+				(unsigned char)( (n - k < rsize - 1) ? n - k
+							: rsize - 1 ) );
+		tdec += now() - t;
+
+		if ( r != 1 || memcmp( out, blk, usize * group ) )
+		{
+			fprintf( stderr, "block %lu: decoded block differs\n", b );
+			return 1;
+		}
+	}
+
+	printf( "records %lu, usize %u, group %u, rec_size %u, window %u\n",
+		nblk * group, usize, group, rsize, (unsigned) LOG_LZ_WINDOW );
+	printf( "ratio %.2f (user bytes %lu, log bytes %lu)\n",
+		(double) nblk * group * usize / ((double) logrecs * rsize),
+		nblk * group * usize, logrecs * rsize );
+	printf( "log records per block %.2f (uncompressed %.2f)\n",
+		(double) logrecs / nblk,
+		(double) group * usize / (rsize - 1) );
+	printf( "calls of Log_LzFlush per block %.2f (LOG_LZ_STEP %u)\n",
+		(double) calls / nblk, (unsigned) LOG_LZ_STEP );
+	printf( "encode %.1f ns/byte, decode %.1f ns/byte\n",
+		tenc * 1e9 / (nblk * group * usize),
+		tdec * 1e9 / (nblk * group * usize) );
+	return 0;
+}
+
+
+/* End of file  ee-logs-lzbench.c */
@@ -0,0 +1,307 @@
+/* ee-logs-mmap.c */
+/*
+ Benchmark and crash test of log of many processes in mapped file
+ (ee-mmap.h)
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host, Linux):
+	cc -O2 -o ee-logs-mmap ee-logs-mmap.c
+
+ Usage:
+	ee-logs-mmap [-r RECS] [-s REC_SIZE] [-p PROCS] [-n RECORDS]
+		[-b BATCH] [-k ROUNDS] FILE
+
+	FILE is created anew (log of RECS records, default 255, of
+	REC_SIZE bytes, default 16, not less than 6).  PROCS processes
+	(default 4) open it and append RECORDS records (default 100000)
+	each; msync every BATCH records (default 256, 0 -- never).
+	Printed: appends per second of all processes.
+
+	With -k: ROUNDS rounds of crash test instead (after the check
+	that a late abort of a record does not change records which are
+	committed by a process which is dead now).  In every round
+	PROCS processes append records, one of them is killed (SIGKILL)
+	after a random time, others work for 3 * LOG_MM_STALL_MS more
+	(they abort records of the dead process) and are killed too;
+	then the file is opened again (repaired).  The other processes
+	must append records after the kill.
+
+	Checked after every run (round): the ring is found by flags (as
+	ee-logs-decode does) and the header agrees with it; records of
+	every process are in order of appending; every record is valid
+	(check byte) or is an aborted record of zeros, except the oldest
+	PROCS records (slots of records which were not committed).  Exit
+	status is 1 on the first error (it is printed).
+
+	Records: number of process, sequence number (4 bytes, the
+	number of round in high byte), filler, check byte.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "ee-image.h"
+#include "ee-mmap.h"
+
+#define MAXP	64
+
+static unsigned recs = 255, rec_size = 16, batch = 256;
+static int nproc = 4;
+static unsigned long nrec = 100000;
+static const char * file;
+
+
+static unsigned char
+check( const unsigned char * r )
+{
+	unsigned char c = 0x5A;
+	unsigned i;
+	for ( i = 0; i + 1 < rec_size; ++i ) c ^= r[i];
+	return (unsigned char)( c & 0x7F );
+}
+
+static void
+make( unsigned char * r, int p, unsigned long seq )
+{
+	unsigned i;
+	r[0] = (unsigned char) p;
+	for ( i = 1; i < 5; ++i ) r[i] = (unsigned char)( seq >> (i - 1) * 8 );
+	for ( ; i + 1 < rec_size; ++i ) r[i] = (unsigned char)( seq * 7 + i );
+	r[rec_size - 1] = check( r );
+}
+
+static int
+fail( const char * msg, unsigned k, const unsigned char * r )
+{
+	printf( "error: %s (record %u of log: %02x %02x %02x %02x %02x)\n",
+		msg, k, r[0], r[1], r[2], r[3], r[4] );
+	return 1;
+}
+
+/* append records with sequence numbers from seq (forever if n == 0) */
+static void
+writer( int p, unsigned long seq, unsigned long n )
+{
+	struct Log_Mmap m;
+	unsigned char r[255];
+	unsigned long k;
+	if ( Log_MmOpen( &m, file, recs, rec_size, batch ) )
+	{
+		perror( file );
+		_exit( 2 );
+	}
+	for ( k = 0; !n || k < n; ++k )
+	{
+		make( r, p, seq + k );
+		Log_MmAppend( &m, r );
+	}
+	Log_MmClose( &m );
+	_exit( 0 );
+}
+
+/* check log of file m; count aborted records in *zeros */
+static int
+verify( struct Log_Mmap * m, unsigned long * zeros )
+{
+	struct Log_Geom g = { 0, 0, LOG_MM_HDR, 0 };
+	struct Log_Ring ring;
+	unsigned long last[MAXP];
+	int seen[MAXP];
+	unsigned char r[255];
+	unsigned k, i;
+
+	g.recs = recs;
+	g.rec_size = rec_size;
+	if ( Log_RingInit( &ring, m->map, m->len, &g ) )
+		return fail( "no ring", 0, m->map );
+	if ( ring.cur != m->h->committed % recs
+		|| m->h->committed != m->h->reserved )
+	{
+		printf( "error: free slot %u, header: %lu reserved, "
+			"%lu committed\n", ring.cur,
+			(unsigned long) m->h->reserved,
+			(unsigned long) m->h->committed );
+		return 1;
+	}
+	memset( seen, 0, sizeof seen );
+	for ( k = 0; k < Log_RingCount( &ring ); ++k )
+	{
+		unsigned long s = 0;
+		Log_RingCopy( &ring, k, r );
+		for ( i = 0; i < rec_size && !r[i]; ++i ) ;
+		if ( i == rec_size ) { ++ *zeros; continue; }
+		if ( k < (unsigned) nproc ) continue;
+		if ( r[0] >= nproc || check( r ) != r[rec_size - 1] )
+			return fail( "damaged record", k, r );
+		for ( i = 4; i; --i ) s = s << 8 | r[i];
+		if ( seen[r[0]] && s <= last[r[0]] )
+			return fail( "record out of order", k, r );
+		seen[r[0]] = 1;
+		last[r[0]] = s;
+	}
+	return 0;
+}
+
+/* a late abort (by a process which read number c of the record before
+   the record is committed by other process which is dead now) does not
+   change the committed records */
+static int
+late_rescue( struct Log_Mmap * m )
+{
+	uint64_t c = m->h->committed, a = m->h->aborted;
+	unsigned char r[255];
+	pid_t w;
+	int st;
+	if ( !(w = fork()) ) writer( 0, 0, 3 );
+	waitpid( w, &st, 0 );
+	Log_MmRescue( m, c );
+	memcpy( r, Log_MmSlot( m, c ), rec_size );
+	r[rec_size - 1] &= (unsigned char)~LOG_FLAG_MASK;
+	if ( m->h->committed != c + 3 || m->h->aborted != a
+		|| check( r ) != r[rec_size - 1] )
+	{
+		printf( "error: late abort of committed record: %lu records "
+			"committed (not %lu), %lu aborted\n",
+			(unsigned long)( m->h->committed - c ), 3UL,
+			(unsigned long)( m->h->aborted - a ) );
+		return 1;
+	}
+	return 0;
+}
+
+static void
+pause_ms( long ms )
+{
+	struct timespec t;
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = ms % 1000 * 1000000L;
+	nanosleep( &t, 0 );
+}
+
+
+int
+main( int argc, char ** argv )
+{
+	struct Log_Mmap m;
+	pid_t w[MAXP];
+	unsigned long zeros = 0, rounds = 0, k;
+	uint64_t c0;
+	double t;
+	int c, p;
+
+	while ( (c = getopt( argc, argv, "r:s:p:n:b:k:" )) != -1 )
+	{
+		switch ( c )
+		{
+		case 'r': recs = (unsigned) atoi( optarg ); break;
+		case 's': rec_size = (unsigned) atoi( optarg ); break;
+		case 'p': nproc = atoi( optarg ); break;
+		case 'n': nrec = strtoul( optarg, 0, 0 ); break;
+		case 'b': batch = (unsigned) atoi( optarg ); break;
+		case 'k': rounds = strtoul( optarg, 0, 0 ); break;
+		default:
+			goto usage;
+		}
+	}
+	if ( optind + 1 != argc ) goto usage;
+	file = argv[optind];
+	if ( rec_size < 6 || nproc < 1 || nproc > MAXP
+		|| (recs < (unsigned) nproc + 2) )
+		goto usage;
+
+	unlink( file );
+	if ( Log_MmOpen( &m, file, recs, rec_size, batch ) )
+	{
+		perror( file );
+		return 2;
+	}
+
+	if ( !rounds )
+	{
+		c0 = m.h->committed;
+		t = Log_MmNow();
+		for ( p = 0; p < nproc; ++p )
+			if ( !(w[p] = fork()) ) writer( p, 0, nrec );
+		for ( p = 0; p < nproc; ++p ) waitpid( w[p], &c, 0 );
+		t = ( Log_MmNow() - t ) * 1e-3;
+		if ( m.h->committed - c0 != nrec * nproc || m.h->aborted )
+		{
+			printf( "error: %lu records committed, %lu aborted\n",
+				(unsigned long)( m.h->committed - c0 ),
+				(unsigned long) m.h->aborted );
+			return 1;
+		}
+		if ( verify( &m, &zeros ) ) return 1;
+		printf( "%d processes, %u records of %u bytes, msync every %u: "
+			"%lu appends, %.0f appends/s, ok\n", nproc, recs,
+			rec_size, batch, nrec * nproc, nrec * nproc / t );
+		Log_MmClose( &m );
+		return 0;
+	}
+
+	srand( (unsigned) getpid() );
+	if ( late_rescue( &m ) ) return 1;
+	for ( k = 1; k <= rounds; ++k )
+	{
+		for ( p = 0; p < nproc; ++p )
+			if ( !(w[p] = fork()) ) writer( p, k << 24, 0 );
+		pause_ms( 1 + rand() % 20 );
+		kill( w[0], SIGKILL );
+		waitpid( w[0], &c, 0 );
+		c0 = Log_MmLoad( &m.h->committed );
+		pause_ms( 3 * LOG_MM_STALL_MS );
+		if ( nproc > 1 && Log_MmLoad( &m.h->committed ) - c0 < recs )
+		{
+			printf( "error: writers are stopped by the dead one\n" );
+			return 1;
+		}
+		for ( p = 1; p < nproc; ++p )
+		{
+			kill( w[p], SIGKILL );
+			waitpid( w[p], &c, 0 );
+		}
+		Log_MmClose( &m );
+		if ( Log_MmOpen( &m, file, recs, rec_size, batch ) )
+		{
+			perror( file );
+			return 2;
+		}
+		if ( verify( &m, &zeros ) ) return 1;
+	}
+	printf( "%lu rounds of %d processes: %lu records appended, "
+		"%lu aborted, %lu aborted records in logs, ok\n", rounds, nproc,
+		(unsigned long) m.h->committed, (unsigned long) m.h->aborted,
+		zeros );
+	Log_MmClose( &m );
+	return 0;
+
+usage:
+	fprintf( stderr, "usage: %s [-r RECS] [-s REC_SIZE] [-p PROCS] "
+		"[-n RECORDS] [-b BATCH] [-k ROUNDS] FILE\n", argv[0] );
+	return 2;
+}
+
+
+/* End of file  ee-logs-mmap.c */
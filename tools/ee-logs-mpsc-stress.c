@@ -0,0 +1,258 @@
+/* ee-logs-mpsc-stress.c */
+/*
+ Stress test of ring of many producers (ee-logs-mpsc.h) by threads
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host):
+	cc -O2 -pthread -o ee-logs-mpsc-stress ee-logs-mpsc-stress.c
+	cc -O2 -pthread -DSTRESS_CRITICAL -o ee-logs-mpsc-stress-cs	\
+		ee-logs-mpsc-stress.c
+
+	(STRESS_QLEN, default 8, is QLEN of the ring; with
+	STRESS_CRITICAL slots are reserved in LOG_CRITICAL_BEGIN/END
+	made by a spin lock, else by atomic compare and swap; options
+	of ee-logs.h are set by -D)
+
+ Usage:
+	ee-logs-mpsc-stress [-p PRODUCERS] [-n RECORDS]
+
+	PRODUCERS threads (default 4) push RECORDS records (default
+	1000000) each with number of producer and sequence number in
+	bursts of random length (with Log_MpscPush or with
+	Log_MpscReserve and Log_MpscCommit); a full ring loses records,
+	as an interrupt does.  One thread (consumer) writes records to
+	log on simulated EEPROM (ee-sim.h) by Log_MpscDrain.
+
+	Checked: records of every producer are written in order without
+	gaps and copies (LOG_WRITE_HOOK), written and lost records are
+	all pushed records, lost records are Log_MpscLost, and the last
+	records of log in EEPROM are the last written records.  Exit
+	status is 1 on the first error (it is printed).
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EE_SIM_DEVICE
+#include "ee-sim.h"
+
+#ifdef STRESS_CRITICAL
+static int lock;
+#define LOG_CRITICAL_BEGIN()						\
+	while ( __atomic_exchange_n( &lock, 1, __ATOMIC_ACQUIRE ) ) ;
+#define LOG_CRITICAL_END()						\
+	__atomic_store_n( &lock, 0, __ATOMIC_RELEASE );
+#endif
+
+#define LOG_WRITE_HOOK( name, slot, rec )	hook( rec )
+static void hook( const unsigned char * rec );
+
+#include "../ee-logs.h"
+#include "../ee-logs-mpsc.h"
+
+#ifndef STRESS_QLEN
+#define STRESS_QLEN	8
+#endif
+
+#define RECS		64
+#define REC_SIZE	4
+#define MAXP		64
+
+DECLARE_LOGGER( S, RECS, REC_SIZE, 0 )
+DECLARE_LOG_MPSC( S )
+LOGGER( S, RECS, REC_SIZE, 0 )
+LOG_MPSC( S, REC_SIZE, STRESS_QLEN )
+
+
+static unsigned long nrec = 1000000;
+static int nprod = 4;
+
+static unsigned long pushed[MAXP], lost[MAXP];	/* by producers */
+static unsigned long next_seq[MAXP];		/* expected by consumer */
+static unsigned long written;
+static int done;				/* producers are ended */
+
+/* the last written records (for the check of EEPROM) */
+static unsigned char hist[RECS][REC_SIZE];
+
+
+/* record: producer, sequence number (low 16 bits), check byte */
+static void
+make( unsigned char * r, int p, unsigned long seq )
+{
+	r[0] = (unsigned char) p;
+	r[1] = (unsigned char) seq;
+	r[2] = (unsigned char)( seq >> 8 );
+	r[3] = (unsigned char)( (r[0] ^ r[1] ^ r[2] ^ 0x55) & 0x7F );
+}
+
+static void
+fail( const char * msg, const unsigned char * r )
+{
+	printf( "error: %s (record %02x %02x %02x %02x)\n", msg,
+		r[0], r[1], r[2], r[3] );
+	exit( 1 );
+}
+
+static void
+hook( const unsigned char * rec )
+{
+	unsigned char e[REC_SIZE];
+	int p = rec[0];
+	if ( p >= nprod ) fail( "bad producer", rec );
+	make( e, p, next_seq[p] );
+	e[3] |= rec[3] & LOG_FLAG_MASK;
+	if ( memcmp( e, rec, REC_SIZE ) )
+		fail( "record out of order, lost or damaged", rec );
+	++ next_seq[p];
+	memcpy( hist[written % RECS], rec, REC_SIZE );
+	hist[written % RECS][REC_SIZE-1] &= (unsigned char)~LOG_FLAG_MASK;
+	++ written;
+}
+
+static void *
+producer( void * arg )
+{
+	int p = (int)(size_t) arg;
+	unsigned long seq = 0, k = 0;
+	unsigned int rnd = (unsigned int) p * 2654435761u + 1;
+	unsigned char r[REC_SIZE], * s;
+	while ( k < nrec )
+	{
+		/* a burst, then a pause */
+		unsigned n = (rnd >> 16) % 32 + 1;
+		for ( ; n && k < nrec; --n, ++k )
+		{
+			make( r, p, seq );
+			if ( k & 1 )
+			{
+				if ( !Log_MpscPush( S, r ) )
+					{ ++ lost[p]; continue; }
+			} else {
+				if ( !(s = Log_MpscReserve( S )) )
+					{ ++ lost[p]; continue; }
+				memcpy( s, r, REC_SIZE );
+				Log_MpscCommit( S, s );
+			}
+			++ seq;
+			++ pushed[p];
+		}
+		rnd = rnd * 1103515245u + 12345u;
+		if ( rnd & 0x100000 ) sched_yield();
+	}
+	return 0;
+}
+
+static void *
+consumer( void * arg )
+{
+	(void) arg;
+	for ( ;; )
+	{
+		int d = __atomic_load_n( &done, __ATOMIC_ACQUIRE );
+		if ( Log_MpscDrain( S ) && d ) break;
+	}
+	return 0;
+}
+
+
+int
+main( int argc, char ** argv )
+{
+	pthread_t th[MAXP], cons;
+	unsigned long all = 0, nlost = 0, k;
+	unsigned char d[REC_SIZE];
+	double t;
+	struct timespec t0, t1;
+	int c, p;
+
+	while ( (c = getopt( argc, argv, "p:n:" )) != -1 )
+	{
+		switch ( c )
+		{
+		case 'p': nprod = atoi( optarg ); break;
+		case 'n': nrec = strtoul( optarg, 0, 0 ); break;
+		default:
+			fprintf( stderr, "usage: %s [-p PRODUCERS] [-n RECORDS]\n",
+				argv[0] );
+			return 2;
+		}
+	}
+	if ( nprod < 1 || nprod > MAXP ) nprod = MAXP;
+
+	for ( k = 0; k < sizeof Ee_Mem; ++k ) Ee_Mem[k] = (unsigned char) rand();
+	Log_Init( S );
+
+	clock_gettime( CLOCK_MONOTONIC, &t0 );
+	pthread_create( &cons, 0, consumer, 0 );
+	for ( p = 0; p < nprod; ++p )
+		pthread_create( &th[p], 0, producer, (void *)(size_t) p );
+	for ( p = 0; p < nprod; ++p ) pthread_join( th[p], 0 );
+	__atomic_store_n( &done, 1, __ATOMIC_RELEASE );
+	pthread_join( cons, 0 );
+	clock_gettime( CLOCK_MONOTONIC, &t1 );
+	t = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+	for ( p = 0; p < nprod; ++p )
+	{
+		if ( next_seq[p] != pushed[p] )
+		{
+			printf( "error: producer %d pushed %lu records, "
+				"written %lu\n", p, pushed[p], next_seq[p] );
+			return 1;
+		}
+		all += pushed[p];
+		nlost += lost[p];
+	}
+	if ( (unsigned int) nlost != Log_MpscLost( S ) )
+	{
+		printf( "error: lost %lu records, Log_MpscLost %u\n", nlost,
+			Log_MpscLost( S ) );
+		return 1;
+	}
+
+	/* the last records of log */
+	Log_Init( S );
+	Log_ReadLast( S, d );
+	for ( k = 0; k < RECS-1 && k < written; ++k )
+	{
+		if ( memcmp( d, hist[(written - 1 - k) % RECS], REC_SIZE ) )
+			fail( "EEPROM has not the written record", d );
+		if ( !Log_ReadPrev( S, d ) ) break;
+	}
+
+	printf( "%d producers, QLEN %d (%s): %lu pushed, %lu lost, "
+		"%.0f records/s, ok\n", nprod, STRESS_QLEN,
+#ifdef STRESS_CRITICAL
+		"critical section",
+#else
+		"compare and swap",
+#endif
+		all, nlost, all / t );
+	return 0;
+}
+
+
+/* End of file  ee-logs-mpsc-stress.c */
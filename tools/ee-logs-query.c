@@ -0,0 +1,372 @@
+/* ee-logs-query.c */
+/*
+ Parallel query over many images of EEPROM
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host):
+	cc -O2 -pthread -o ee-logs-query ee-logs-query.c
+
+ Usage:
+	ee-logs-query -n RECS -s REC_SIZE [-a START_ADDR] [-P PAGE]
+			[-j THREADS] [-w PREDICATE]... [-H FIELD] [-p] [-l LIST] [IMAGE]...
+
+	Images (from command line and from file LIST, one name per
+	line) are mapped to memory and processed by THREADS threads
+	(default: number of processors); every thread takes the next
+	image, finds the ring of log in it (see ee-image.h) and checks
+	every record of log with all predicates.  Counters are kept
+	by every thread and merged at end.
+
+	-P: records are in slots of LOG_PAGE_ALIGN for LOG_PAGE_SIZE
+	PAGE (see ee-logs.h).
+
+	FIELD is OFFSET[:WIDTH] -- little endian unsigned number of
+	WIDTH bytes (1..4, default 1) from byte OFFSET of record
+	(flag bit is cleared as Log_Read* functions do).
+
+	PREDICATE is FIELD OP VALUE, where OP is one of
+		=  !=  <  <=  >  >=  &	(& -- FIELD & VALUE is not 0),
+	for example '-w 4=9 -w 0:4>=1500'.  A record matches if all
+	predicates are true.
+
+	Number of images, records and matched records is printed.
+	-H FIELD: histogram of FIELD (WIDTH 1 or 2) of matched records.
+	-p: print matched records as 'IMAGE K: bytes' (in order of
+	images and records).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "ee-image.h"
+
+
+#define MAX_PRED	16
+
+enum { OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, OP_AND };
+
+struct Field {
+	unsigned off, width;
+};
+
+struct Pred {
+	struct Field f;
+	int op;
+	unsigned long v;
+};
+
+struct Worker {
+	pthread_t th;
+	unsigned long nrecs, nmatch, nbad;
+	unsigned long * hist;		/* 1 << (8 * hist width) counters */
+};
+
+
+static struct Log_Geom geom;
+static struct Pred pred[MAX_PRED];
+static unsigned npred;
+static struct Field hfield;
+static int hist, print;
+
+static char ** files;
+static unsigned nfiles;
+static unsigned next_file;		/* the next image to process */
+static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+static char ** outs;			/* printed records of images */
+
+
+/* value of field of record p (flag bit of the last byte is cleared) */
+static inline unsigned long
+field( const unsigned char * p, const struct Field * f )
+{
+	unsigned long v = 0;
+	unsigned i = f->width;
+	while ( i-- )
+	{
+		unsigned char b = p[f->off + i];
+		if ( f->off + i == geom.rec_size - 1 ) b &= (unsigned char)~LOG_FLAG_MASK;
+		v = (v << 8) | b;
+	}
+	return v;
+}
+
+static inline int
+match( const unsigned char * p )
+{
+	unsigned k;
+	for ( k = 0; k < npred; ++k )
+	{
+		unsigned long v = field( p, &pred[k].f );
+		switch ( pred[k].op )
+		{
+		case OP_EQ: if ( v != pred[k].v ) return 0; break;
+		case OP_NE: if ( v == pred[k].v ) return 0; break;
+		case OP_LT: if ( v >= pred[k].v ) return 0; break;
+		case OP_LE: if ( v > pred[k].v ) return 0; break;
+		case OP_GT: if ( v <= pred[k].v ) return 0; break;
+		case OP_GE: if ( v < pred[k].v ) return 0; break;
+		default: if ( !(v & pred[k].v) ) return 0; break;
+		}
+	}
+	return 1;
+}
+
+
+static void
+query_image( struct Worker * w, unsigned n )
+{
+	struct Log_Ring r;
+	struct stat st;
+	unsigned char * img;
+	char * buf = 0;
+	size_t blen = 0;
+	FILE * out = 0;
+	unsigned long nmatch = 0;	/* workers share cache lines of w[] */
+	unsigned k, i;
+	int fd = open( files[n], O_RDONLY );
+
+	if ( fd < 0 || fstat( fd, &st ) || st.st_size == 0 )
+	{
+		if ( fd >= 0 ) close( fd );
+		++w->nbad;
+		return;
+	}
+	img = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( img == MAP_FAILED ) { ++w->nbad; return; }
+	if ( Log_RingInit( &r, img, st.st_size, &geom ) )
+	{
+		munmap( img, st.st_size );
+		++w->nbad;
+		return;
+	}
+	if ( print ) out = open_memstream( &buf, &blen );
+
+	for ( k = 0; k < Log_RingCount( &r ); ++k )
+	{
+		const unsigned char * p = Log_RingRec( &r, k );
+		if ( !match( p ) ) continue;
+		++nmatch;
+		if ( hist ) ++w->hist[field( p, &hfield )];
+		if ( out )
+		{
+			fprintf( out, "%s %u:", files[n], k );
+			for ( i = 0; i < geom.rec_size - 1; ++i )
+				fprintf( out, " %02x", p[i] );
+			fprintf( out, " %02x\n", p[i] & (unsigned char)~LOG_FLAG_MASK );
+		}
+	}
+	w->nrecs += Log_RingCount( &r );
+	w->nmatch += nmatch;
+	munmap( img, st.st_size );
+	if ( out ) { fclose( out ); outs[n] = buf; }
+}
+
+static void *
+worker( void * arg )
+{
+	struct Worker * w = arg;
+	for ( ;; )
+	{
+		unsigned n;
+		pthread_mutex_lock( &next_lock );
+		n = next_file++;
+		pthread_mutex_unlock( &next_lock );
+		if ( n >= nfiles ) return 0;
+		query_image( w, n );
+	}
+}
+
+
+static int
+parse_field( const char * s, struct Field * f, char ** end )
+{
+	char * e;
+	f->off = strtoul( s, &e, 0 );
+	f->width = 1;
+	if ( *e == ':' ) f->width = strtoul( e + 1, &e, 0 );
+	*end = e;
+	if ( e == s || f->width < 1 || f->width > 4
+		|| f->off + f->width > geom.rec_size )
+		return -1;
+	return 0;
+}
+
+static int
+parse_pred( const char * s, struct Pred * p )
+{
+	static const char * ops[] = { "=", "!=", "<", "<=", ">", ">=", "&" };
+	char * e, * v;
+	int k;
+	if ( parse_field( s, &p->f, &e ) ) return -1;
+	for ( v = e; *v && strchr( "=!<>&", *v ); ++v ) ;
+	for ( k = 0; k < 7; ++k )
+		if ( (size_t)(v - e) == strlen( ops[k] ) && !strncmp( e, ops[k], v - e ) )
+			break;
+	if ( k == 7 || !*v ) return -1;
+	p->op = k;
+	p->v = strtoul( v, &e, 0 );
+	return *e ? -1 : 0;
+}
+
+static void
+add_file( const char * fn )
+{
+	static unsigned cap;
+	if ( nfiles == cap )
+	{
+		cap = cap ? 2 * cap : 1024;
+		files = realloc( files, cap * sizeof *files );
+		if ( !files ) { perror( "realloc" ); exit( 1 ); }
+	}
+	files[nfiles++] = strdup( fn );
+}
+
+
+static void
+usage( const char * prog )
+{
+	fprintf( stderr, "usage: %s -n RECS -s REC_SIZE [-a START_ADDR]"
+		" [-P PAGE] [-j THREADS] [-w PREDICATE]... [-H FIELD] [-p]"
+		" [-l LIST] [IMAGE]...\n", prog );
+	exit( 2 );
+}
+
+
+int
+main( int argc, char ** argv )
+{
+	const char * ws[MAX_PRED], * hs = 0, * lfn = 0;
+	struct Worker * w;
+	struct timeval t0, t1;
+	unsigned long nrecs = 0, nmatch = 0, nbad = 0, * h = 0;
+	long nth = 0;
+	unsigned k, j, hsize = 0, page = 0;
+	double dt;
+	int c;
+
+	while ( (c = getopt( argc, argv, "n:s:a:P:j:w:H:pl:" )) != -1 )
+	{
+		switch ( c )
+		{
+		case 'n': geom.recs = strtoul( optarg, 0, 0 ); break;
+		case 's': geom.rec_size = strtoul( optarg, 0, 0 ); break;
+		case 'a': geom.start = strtoul( optarg, 0, 0 ); break;
+		case 'P': page = strtoul( optarg, 0, 0 ); break;
+		case 'j': nth = strtol( optarg, 0, 0 ); break;
+		case 'w':
+			if ( npred == MAX_PRED ) usage( argv[0] );
+			ws[npred++] = optarg;
+			break;
+		case 'H': hs = optarg; hist = 1; break;
+		case 'p': print = 1; break;
+		case 'l': lfn = optarg; break;
+		default: usage( argv[0] );
+		}
+	}
+	if ( !geom.recs || !geom.rec_size ) usage( argv[0] );
+	if ( page & (page - 1) || page > 256 ) usage( argv[0] );
+	if ( page ) geom.slot = Log_SlotSize( geom.rec_size, page );
+	for ( k = 0; k < npred; ++k )
+		if ( parse_pred( ws[k], &pred[k] ) )
+		{
+			fprintf( stderr, "bad predicate: %s\n", ws[k] );
+			return 2;
+		}
+	if ( hs )
+	{
+		char * e;
+		if ( parse_field( hs, &hfield, &e ) || *e || hfield.width > 2 )
+		{
+			fprintf( stderr, "bad field of histogram: %s\n", hs );
+			return 2;
+		}
+		hsize = 1u << (8 * hfield.width);
+	}
+
+	for ( ; optind < argc; ++optind ) add_file( argv[optind] );
+	if ( lfn )
+	{
+		char line[4096];
+		FILE * f = fopen( lfn, "r" );
+		if ( !f ) { perror( lfn ); return 1; }
+		while ( fgets( line, sizeof line, f ) )
+		{
+			line[strcspn( line, "\r\n" )] = 0;
+			if ( *line ) add_file( line );
+		}
+		fclose( f );
+	}
+	if ( !nfiles ) usage( argv[0] );
+	if ( print && !(outs = calloc( nfiles, sizeof *outs )) ) return 1;
+
+	if ( nth <= 0 ) nth = sysconf( _SC_NPROCESSORS_ONLN );
+	if ( nth <= 0 ) nth = 1;
+	if ( (unsigned long) nth > nfiles ) nth = nfiles;
+	w = calloc( nth, sizeof *w );
+	if ( !w ) return 1;
+
+	gettimeofday( &t0, 0 );
+	for ( j = 0; j < nth; ++j )
+	{
+		if ( hist && !(w[j].hist = calloc( hsize, sizeof *w[j].hist )) )
+			return 1;
+		if ( pthread_create( &w[j].th, 0, worker, &w[j] ) )
+		{
+			perror( "pthread_create" );
+			return 1;
+		}
+	}
+	for ( j = 0; j < nth; ++j ) pthread_join( w[j].th, 0 );
+	gettimeofday( &t1, 0 );
+
+	/* merge */
+	if ( hist ) h = w[0].hist;
+	for ( j = 0; j < nth; ++j )
+	{
+		nrecs += w[j].nrecs;
+		nmatch += w[j].nmatch;
+		nbad += w[j].nbad;
+		if ( hist && j ) for ( k = 0; k < hsize; ++k ) h[k] += w[j].hist[k];
+	}
+
+	if ( print )
+		for ( k = 0; k < nfiles; ++k )
+			if ( outs[k] ) fputs( outs[k], stdout );
+	if ( hist )
+		for ( k = 0; k < hsize; ++k )
+			if ( h[k] ) printf( "%u\t%lu\n", k, h[k] );
+	dt = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) * 1e-6;
+	fprintf( stderr, "%u images (%lu bad), %lu records, %lu matched,"
+		" %ld threads, %.3f s (%.0f records/s)\n",
+		nfiles, nbad, nrecs, nmatch, nth, dt, dt > 0 ? nrecs / dt : 0.0 );
+	if ( !print && !hist ) printf( "%lu\n", nmatch );
+	return 0;
+}
+
+
+/* End of file  ee-logs-query.c */
@@ -0,0 +1,262 @@
+/* ee-logs-recv.c */
+/*
+ Receiver of logs exported over UART (see ee-logs-export.h)
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ Build (host):
+	cc -O2 -o ee-logs-recv ee-logs-recv.c
+
+ Usage:
+	ee-logs-recv [-b BAUD] [-t MS] [-o OUT] TTY
+
+	TTY is a serial port connected to device (or a slave of
+	pseudo-terminal of ee-logs-devsim).  Receiver sends
+	LOG_EXP_NAK 0 at start (a device may start export by it),
+	then receives frames and answers by LOG_EXP_ACK after every
+	good frame and by LOG_EXP_NAK after the first broken or lost
+	frame (and after every broken repeat of the expected frame).
+	If nothing is received for MS milliseconds (default 1000)
+	LOG_EXP_NAK is sent again.
+
+	Records are written to OUT (binary, from the oldest one) or
+	printed to stdout in hex (flag bit is cleared as Log_Read*
+	functions do).  Statistics are printed to stderr.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+#define LOG_FLAG_MASK	((unsigned char)0x80)
+#define LOG_EXP_SOF	((unsigned char)0xA5)
+#define LOG_EXP_ACK	((unsigned char)0x06)
+#define LOG_EXP_NAK	((unsigned char)0x15)
+
+
+static unsigned int
+crc16( unsigned int crc, unsigned char b )
+{
+	int i;
+	crc ^= (unsigned int) b << 8;
+	for ( i = 0; i < 8; ++i )
+		crc = ( crc & 0x8000 ) ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc & 0xFFFF;
+}
+
+
+static speed_t
+baud( long b )
+{
+	switch ( b )
+	{
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+#ifdef B460800
+	case 460800: return B460800;
+#endif
+#ifdef B921600
+	case 921600: return B921600;
+#endif
+	}
+	fprintf( stderr, "unsupported baud rate %ld\n", b );
+	exit( 2 );
+}
+
+
+static void
+answer( int fd, unsigned char type, unsigned char seq )
+{
+	unsigned char a[2];
+	a[0] = type;
+	a[1] = seq;
+	if ( write( fd, a, 2 ) != 2 ) perror( "write" );
+}
+
+
+static double
+now( void )
+{
+	struct timeval tv;
+	gettimeofday( &tv, 0 );
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static void
+usage( const char * prog )
+{
+	fprintf( stderr, "usage: %s [-b BAUD] [-t MS] [-o OUT] TTY\n", prog );
+	exit( 2 );
+}
+
+
+int
+main( int argc, char ** argv )
+{
+	static unsigned char frame[5 + 255 * 255 + 2];
+	const char * ofn = 0;
+	FILE * out = 0;
+	long br = 0, tmo = 1000;
+	struct termios t;
+	unsigned char expect = 0, nak = 0, bt;
+	unsigned rec_size = 0;
+	unsigned long pos = 0, need = 0;
+	unsigned long nrecs = 0, nframes = 0, nbad = 0, nbytes = 0;
+	double t0 = 0;
+	int fd, c;
+
+	while ( (c = getopt( argc, argv, "b:t:o:" )) != -1 )
+	{
+		switch ( c )
+		{
+		case 'b': br = strtol( optarg, 0, 0 ); break;
+		case 't': tmo = strtol( optarg, 0, 0 ); break;
+		case 'o': ofn = optarg; break;
+		default: usage( argv[0] );
+		}
+	}
+	if ( optind + 1 != argc || tmo <= 0 ) usage( argv[0] );
+
+	fd = open( argv[optind], O_RDWR | O_NOCTTY );
+	if ( fd < 0 ) { perror( argv[optind] ); return 1; }
+	if ( tcgetattr( fd, &t ) == 0 )
+	{
+		cfmakeraw( &t );
+		if ( br ) { cfsetispeed( &t, baud( br ) ); cfsetospeed( &t, baud( br ) ); }
+		tcsetattr( fd, TCSANOW, &t );
+	}
+	if ( ofn && !(out = fopen( ofn, "wb" )) ) { perror( ofn ); return 1; }
+
+	answer( fd, LOG_EXP_NAK, 0 );		/* ready */
+	for ( ;; )
+	{
+		fd_set rs;
+		struct timeval tv;
+		unsigned char buf[4096];
+		ssize_t n, i;
+
+		FD_ZERO( &rs );
+		FD_SET( fd, &rs );
+		tv.tv_sec = tmo / 1000;
+		tv.tv_usec = (tmo % 1000) * 1000;
+		if ( select( fd + 1, &rs, 0, 0, &tv ) == 0 )
+		{ /* nothing is received: ask again */
+			answer( fd, LOG_EXP_NAK, expect );
+			pos = 0;
+			continue;
+		}
+		n = read( fd, buf, sizeof buf );
+		if ( n < 0 && (errno == EINTR || errno == EAGAIN) ) continue;
+		if ( n <= 0 ) { fprintf( stderr, "%s: end of data\n", argv[optind] ); return 1; }
+		if ( !t0 ) t0 = now();
+		nbytes += n;
+
+		for ( i = 0; i < n; ++i )
+		{
+			bt = buf[i];
+			if ( pos == 0 )
+			{ /* search start of frame */
+				if ( bt == LOG_EXP_SOF ) frame[pos++] = bt;
+				continue;
+			}
+			frame[pos++] = bt;
+			if ( pos == 5 )
+			{ /* header: SOF, SEQ, N, REC_SIZE, CHK */
+				if ( (frame[1] ^ frame[2] ^ frame[3] ^ frame[4]) != 0xFF
+					|| frame[3] < 2
+					|| (rec_size && frame[3] != rec_size) )
+				{ /* false start of frame */
+					pos = 0;
+					if ( bt == LOG_EXP_SOF ) frame[pos++] = bt;
+					continue;
+				}
+				need = 5 + (unsigned long) frame[2] * frame[3] + 2;
+			}
+			if ( pos < 5 || pos < need ) continue;
+
+			/* whole frame */
+			{
+				unsigned int crc = 0xFFFF;
+				unsigned long k;
+				unsigned char seq = frame[1], nr = frame[2];
+				unsigned rs = frame[3];
+				pos = 0;
+				for ( k = 1; k < need - 2; ++k ) crc = crc16( crc, frame[k] );
+				if ( crc != ((unsigned) frame[need-2] << 8 | frame[need-1]) )
+				{
+					++nbad;
+					/* the first error or the repeated frame is broken */
+					if ( !nak || seq == expect )
+						answer( fd, LOG_EXP_NAK, expect );
+					nak = 1;
+					continue;
+				}
+				if ( seq != expect )
+				{ /* a frame is lost (or it is repeated) */
+					if ( !nak ) answer( fd, LOG_EXP_NAK, expect );
+					nak = 1;
+					continue;
+				}
+				rec_size = rs;
+				nak = 0;
+				++nframes;
+				answer( fd, LOG_EXP_ACK, ++expect );
+				if ( !nr )
+				{ /* the last frame */
+					double dt = now() - t0;
+					fprintf( stderr, "%lu records, %lu frames, %lu broken,"
+						" %lu bytes in %.3f s (%.0f bytes/s)\n",
+						nrecs, nframes, nbad, nbytes, dt,
+						dt > 0 ? nbytes / dt : 0.0 );
+					if ( out ) fclose( out );
+					close( fd );
+					return 0;
+				}
+				for ( k = 0; k < nr; ++k )
+				{
+					unsigned char * r = frame + 5 + k * rs;
+					r[rs-1] &= (unsigned char)~LOG_FLAG_MASK;
+					if ( out ) fwrite( r, 1, rs, out );
+					else
+					{
+						unsigned j;
+						printf( "%lu:", nrecs );
+						for ( j = 0; j < rs; ++j ) printf( " %02x", r[j] );
+						printf( "\n" );
+					}
+					++nrecs;
+				}
+			}
+		}
+	}
+}
+
+
+/* End of file  ee-logs-recv.c */
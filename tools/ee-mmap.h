@@ -0,0 +1,396 @@
+/* ee-mmap.h */
+/*
+ Log of many processes in mapped file (Linux) with format of
+ In EEPROM logger
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	File has header of LOG_MM_HDR bytes and ring of RECS records of
+	REC_SIZE bytes (an image of EEPROM with log at address
+	LOG_MM_HDR: ee-logs-decode, ee-logs-query and ee-image.h read
+	it).  The file is mapped (MAP_SHARED) by every process which
+	writes or reads the log.
+
+	Header (native byte order, the file is used by processes of
+	one host) has number of reserved and of committed records and
+	for every slot of ring a claim word and pid of its writer.
+	Record N is written to slot N % RECS with flag of pass N / RECS
+	(as Log_NoblockingWrite does after Log_Init of empty ring):
+		1. the writer reserves number N (atomic compare and swap
+		   of reserved records, while the ring has less than
+		   RECS-1 reserved and not committed records);
+		2. claims slot (claim word becomes 4*(N+1));
+		3. writes record without its last byte;
+		4. waits while records before N are not committed;
+		5. marks the slot as committed (claim word becomes
+		   4*(N+1)+2), writes the last byte with flag of pass (one
+		   store) and stores N+1 as number of committed records.
+	So records are committed in order of numbers, and the flags of
+	ring are always valid for Log_Init: a crash of process (or of
+	system) loses only not committed records, and only the oldest
+	records of log (slots of not committed records) may be
+	corrupted, as with batches of Log_Flush of ee-logs.h.
+
+	If the next record is not committed for LOG_MM_STALL_MS
+	milliseconds and its writer is dead (or it did not claim the
+	slot), a waiting writer aborts it (claim word becomes
+	4*(N+1)+1) and commits it as a record of zeros (counted in
+	header; number of committed records is changed from N to N+1
+	by compare and swap); the writer which claims or commits an
+	aborted slot gets error.  Claim words are changed only by
+	compare and swap, so a record which is committed (or claimed by
+	a live process) is never aborted, even if the waiting writer
+	read its number long ago.
+
+	The first process which opens the file (no other process holds
+	it, see flock) repairs the header: number of committed records
+	is found by flags of ring (as Log_Init does), not committed
+	records are dropped.
+
+	Every BATCH committed records (0 -- never) the committing
+	process calls msync( MS_SYNC ) of the file; records after the
+	last msync may be lost if the system crashes (and the newest of
+	them may be torn: pages are written in any order).
+
+
+ Define these macros and functions:
+
+ struct Log_Mmap, LOG_MM_HDR
+
+ int Log_MmOpen( struct Log_Mmap * M, const char * FILE,
+		unsigned RECS, unsigned REC_SIZE, unsigned BATCH )
+	open (create) log in FILE; return 0, or -1 (errno is set;
+	EINVAL: wrong geometry or FILE has other log)
+
+ void Log_MmClose( struct Log_Mmap * M )
+
+ int Log_MmAppend( struct Log_Mmap * M, const unsigned char * REC )
+	append record REC (REC_SIZE bytes, bit LOG_FLAG_MASK of its last
+	byte is not used); return 0, or -1 if the record is aborted by
+	other process (the writer is stopped for LOG_MM_STALL_MS)
+
+ int Log_MmSync( struct Log_Mmap * M )
+	msync( MS_SYNC ) of the file
+
+ M->map, M->len
+	image of the file (for ee-image.h with start LOG_MM_HDR)
+
+
+ Example:
+
+	struct Log_Mmap m;
+	if ( Log_MmOpen( &m, "/var/log/ev.ring", 255, 16, 64 ) ) ...
+	Log_MmAppend( &m, rec );
+	...
+	Log_MmClose( &m );
+
+*/
+
+#ifndef EE_MMAP_H
+#define EE_MMAP_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef LOG_FLAG_MASK
+#define LOG_FLAG_MASK	((unsigned char)0x80)
+#endif
+
+#define LOG_MM_MAGIC	0x4D4D4C45UL	/* "ELMM" */
+#define LOG_MM_VERSION	1
+#define LOG_MM_HDR	4096		/* bytes of header */
+
+#ifndef LOG_MM_STALL_MS
+#define LOG_MM_STALL_MS	100
+#endif
+
+struct Log_MmHdr {
+	uint32_t magic, version;
+	uint32_t recs, rec_size;
+	uint64_t reserved;		/* records reserved */
+	uint64_t committed;		/* records committed */
+	uint64_t aborted;		/* records of dead writers */
+	uint64_t claim[255];		/* 4*(N+1) + Log_MmClaimed.. */
+	int32_t pid[255];		/* writer of slot */
+};
+
+struct Log_Mmap {
+	int fd;
+	unsigned char * map;
+	size_t len;
+	struct Log_MmHdr * h;
+	unsigned char * ring;
+	unsigned recs, rec_size, batch;
+};
+
+/* states of record N in claim word 4*(N+1) + state */
+#define Log_MmClaimed	0
+#define Log_MmAborted	1
+#define Log_MmCommitted	2
+#define Log_MmClaim( n, state )	( 4 * ((n) + 1) + (state) )
+
+#define Log_MmLoad( p )		__atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define Log_MmStore( p, v )	__atomic_store_n( (p), (v), __ATOMIC_RELEASE )
+#define Log_MmCas( p, e, v )						\
+	__atomic_compare_exchange_n( (p), (e), (v), 0,			\
+		__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )
+
+/* flag of record n of ring of recs records */
+static inline unsigned char
+Log_MmFlag( uint64_t n, unsigned recs )
+{
+	return ( (n / recs) & 1 ) ? 0 : LOG_FLAG_MASK;
+}
+
+static inline unsigned char *
+Log_MmSlot( const struct Log_Mmap * m, uint64_t n )
+{
+	return m->ring + (size_t)( n % m->recs ) * m->rec_size;
+}
+
+static double
+Log_MmNow( void )
+{
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec * 1e3 + t.tv_nsec * 1e-6;
+}
+
+/* commit record n (its last byte is d, its slot is marked); msync
+   by batches */
+static void
+Log_MmCommit( struct Log_Mmap * m, uint64_t n, unsigned char d )
+{
+	unsigned char * p = Log_MmSlot( m, n ) + m->rec_size - 1;
+	uint64_t c = n;
+	Log_MmStore( p, (unsigned char)( (d & ~LOG_FLAG_MASK)
+		| Log_MmFlag( n, m->recs ) ) );
+	if ( !Log_MmCas( &m->h->committed, &c, n + 1 ) ) return;
+	if ( m->batch && (n + 1) % m->batch == 0 )
+		msync( m->map, m->len, MS_SYNC );
+}
+
+/* record c is not committed for long time: abort it, if its writer
+   is dead or did not claim the slot */
+static void
+Log_MmRescue( struct Log_Mmap * m, uint64_t c )
+{
+	unsigned s = (unsigned)( c % m->recs );
+	uint64_t v = Log_MmLoad( &m->h->claim[s] );
+	if ( v == Log_MmClaim( c, Log_MmClaimed ) )
+	{
+		pid_t w = Log_MmLoad( &m->h->pid[s] );
+		if ( !(kill( w, 0 ) && errno == ESRCH) ) return;
+	} else if ( v > Log_MmClaim( c, Log_MmClaimed ) )
+		return;			/* aborted, committed or reused */
+	if ( !Log_MmCas( &m->h->claim[s], &v,
+			Log_MmClaim( c, Log_MmAborted ) ) ) return;
+	memset( Log_MmSlot( m, c ), 0, m->rec_size - 1 );
+	__atomic_fetch_add( &m->h->aborted, 1, __ATOMIC_RELAXED );
+	Log_MmCommit( m, c, 0 );
+}
+
+/* wait while less than n records are committed */
+static void
+Log_MmWait( struct Log_Mmap * m, uint64_t n )
+{
+	uint64_t c, last = Log_MmLoad( &m->h->committed );
+	double t = 0;
+	unsigned k = 0;
+	while ( (c = Log_MmLoad( &m->h->committed )) < n )
+	{
+		if ( ++k < 64 ) continue;
+		sched_yield();
+		if ( c != last ) { last = c; t = 0; continue; }
+		if ( !t ) t = Log_MmNow();
+		else if ( Log_MmNow() - t > LOG_MM_STALL_MS )
+		{
+			Log_MmRescue( m, c );
+			t = 0;
+		}
+	}
+}
+
+/* number of committed records by flags of ring (as Log_Init does):
+   the pass is near pass of old number c */
+static uint64_t
+Log_MmScan( const struct Log_Mmap * m, uint64_t c )
+{
+	const unsigned char * r = m->ring + m->rec_size - 1;
+	unsigned char f = r[0] & LOG_FLAG_MASK;
+	uint64_t p = c / m->recs;
+	unsigned cur;
+	for ( cur = 1; cur < m->recs; ++cur )
+		if ( (r[(size_t) cur * m->rec_size] & LOG_FLAG_MASK) != f ) break;
+	if ( cur == m->recs )
+	{ /* all flags are the same: the next pass starts */
+		cur = 0;
+		f ^= LOG_FLAG_MASK;
+	}
+	if ( Log_MmFlag( p * m->recs, m->recs ) != f ) ++p;
+	return p * m->recs + cur;
+}
+
+static int
+Log_MmOpen( struct Log_Mmap * m, const char * file, unsigned recs,
+		unsigned rec_size, unsigned batch )
+{
+	struct stat st;
+	struct Log_MmHdr * h;
+	int excl;
+
+	if ( recs < 2 || recs > 255 || rec_size < 2 || rec_size > 255 )
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	memset( m, 0, sizeof *m );
+	m->recs = recs;
+	m->rec_size = rec_size;
+	m->batch = batch;
+	m->len = LOG_MM_HDR + (size_t) recs * rec_size;
+	m->fd = open( file, O_RDWR | O_CREAT, 0644 );
+	if ( m->fd < 0 ) return -1;
+
+	/* the first user of file repairs it */
+	excl = !flock( m->fd, LOCK_EX | LOCK_NB );
+	if ( !excl && flock( m->fd, LOCK_SH ) ) goto fail;
+	if ( fstat( m->fd, &st ) ) goto fail;
+	if ( st.st_size == 0 && excl )
+	{ /* new file */
+		if ( ftruncate( m->fd, m->len ) ) goto fail;
+	}
+	else if ( (size_t) st.st_size != m->len )
+	{
+		errno = EINVAL;
+		goto fail;
+	}
+	m->map = mmap( 0, m->len, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0 );
+	if ( m->map == MAP_FAILED ) { m->map = 0; goto fail; }
+	m->h = h = (struct Log_MmHdr *) m->map;
+	m->ring = m->map + LOG_MM_HDR;
+
+	if ( excl )
+	{
+		if ( h->magic == 0 )
+		{ /* new file (or its header is not made) */
+			memset( m->map, 0, m->len );
+			h->version = LOG_MM_VERSION;
+			h->recs = recs;
+			h->rec_size = rec_size;
+		}
+		else if ( h->magic != LOG_MM_MAGIC || h->recs != recs
+			|| h->rec_size != rec_size
+			|| h->version != LOG_MM_VERSION )
+		{
+			errno = EINVAL;
+			goto fail;
+		}
+		h->committed = h->reserved = Log_MmScan( m, h->committed );
+		memset( h->claim, 0, sizeof h->claim );
+		memset( h->pid, 0, sizeof h->pid );
+		Log_MmStore( &h->magic, (uint32_t) LOG_MM_MAGIC );
+		msync( m->map, m->len, MS_SYNC );
+		if ( flock( m->fd, LOCK_SH ) ) goto fail;
+	}
+	else if ( Log_MmLoad( &h->magic ) != LOG_MM_MAGIC
+		|| h->recs != recs || h->rec_size != rec_size
+		|| h->version != LOG_MM_VERSION )
+	{
+		errno = EINVAL;
+		goto fail;
+	}
+	return 0;
+
+fail:
+	excl = errno;
+	if ( m->map ) munmap( m->map, m->len );
+	close( m->fd );
+	m->map = 0;
+	errno = excl;
+	return -1;
+}
+
+static void
+Log_MmClose( struct Log_Mmap * m )
+{
+	if ( !m->map ) return;
+	if ( m->batch ) msync( m->map, m->len, MS_SYNC );
+	munmap( m->map, m->len );
+	close( m->fd );				/* releases flock */
+	m->map = 0;
+}
+
+static inline int
+Log_MmSync( struct Log_Mmap * m )
+{
+	return msync( m->map, m->len, MS_SYNC );
+}
+
+static int
+Log_MmAppend( struct Log_Mmap * m, const unsigned char * rec )
+{
+	struct Log_MmHdr * h = m->h;
+	uint64_t n = Log_MmLoad( &h->reserved ), v;
+	unsigned s;
+
+	/* 1. reserve number n (less than recs-1 records in work) */
+	for ( ;; )
+	{
+		if ( n - Log_MmLoad( &h->committed ) >= m->recs - 1 )
+		{
+			Log_MmWait( m, n - (m->recs - 2) );
+			n = Log_MmLoad( &h->reserved );
+			continue;
+		}
+		if ( Log_MmCas( &h->reserved, &n, n + 1 ) ) break;
+	}
+
+	/* 2. claim slot */
+	s = (unsigned)( n % m->recs );
+	Log_MmStore( &h->pid[s], (int32_t) getpid() );
+	v = Log_MmLoad( &h->claim[s] );
+	do {
+		if ( v >= Log_MmClaim( n, Log_MmClaimed ) ) return -1;
+	} while ( !Log_MmCas( &h->claim[s], &v,
+			Log_MmClaim( n, Log_MmClaimed ) ) );
+
+	/* 3. record without the last byte, 4. wait, 5. commit */
+	memcpy( Log_MmSlot( m, n ), rec, m->rec_size - 1 );
+	Log_MmWait( m, n );
+	v = Log_MmClaim( n, Log_MmClaimed );
+	if ( !Log_MmCas( &h->claim[s], &v, Log_MmClaim( n, Log_MmCommitted ) ) )
+		return -1;			/* aborted */
+	Log_MmCommit( m, n, rec[m->rec_size - 1] );
+	return 0;
+}
+
+#endif /* EE_MMAP_H */
+
+
+/* End of file  ee-mmap.h */
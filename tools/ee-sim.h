@@ -0,0 +1,183 @@
+/* ee-sim.h */
+/*
+ Simulated EEPROM and interface of logger engines (for programs on
+ host computer)
+
+ Copyright (C) 2010,2019 Potrepalov I.S.  potrepalov@list.ru
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	An engine is one configuration of logger (ee-logs.h or other
+	implementation with the same interface) built in its own file
+	(see ee-logs-engine.c) with its own simulated EEPROM; programs
+	use engines by struct Log_Engine only, so many engines (with the
+	same names of functions and macros inside) live in one program.
+
+	If EE_SIM_DEVICE is defined before this file, the functions used
+	by ee-logs.h are defined (static): ReadEE, isEEfree, WriteEE,
+	WriteEEPage (if LOG_PAGE_SIZE is defined; write across bound of
+	page is aborted) and ReadEEBlock (if LOG_BURST_READ is defined).
+	Every write keeps EEPROM busy for EE_SIM_BUSY calls of isEEfree
+	(default 2).  Memory of EEPROM is Ee_Mem[EE_SIM_SIZE] (default
+	4096 bytes), counters of operations are in Ee_Stat.  If
+	EE_SIM_FAIL is defined as N, every N-th write (WriteEE or
+	WriteEEPage) is lost: EEPROM is busy, but memory is not changed
+	(to test LOG_VERIFY of ee-logs.h).
+*/
+
+#ifndef EE_SIM_H
+#define EE_SIM_H
+
+
+struct Ee_SimStat {
+	unsigned long reads;		/* ReadEE */
+	unsigned long block_reads;	/* ReadEEBlock */
+	unsigned long writes;		/* WriteEE */
+	unsigned long page_writes;	/* WriteEEPage */
+	unsigned long polls;		/* isEEfree */
+	unsigned long bytes_read;
+	unsigned long bytes_written;
+	unsigned long lost_writes;	/* EE_SIM_FAIL */
+};
+
+/* bus transactions */
+#define Ee_SimOps( s )							\
+	( (s)->reads + (s)->block_reads + (s)->writes + (s)->page_writes )
+
+
+struct Log_Engine {
+	const char * name;
+	unsigned recs, rec_size;
+	unsigned long start;
+	unsigned char * mem;		/* simulated EEPROM */
+	unsigned long mem_size;
+	struct Ee_SimStat * stat;
+
+	void (* init)( void );				/* Log_Init */
+	void (* append)( const unsigned char * src );	/* start writing */
+	void (* sync)( void );				/* end writing */
+	void (* first)( unsigned char * dst );		/* Log_ReadFirst */
+	void (* last)( unsigned char * dst );		/* Log_ReadLast */
+	unsigned char (* next)( unsigned char * dst );	/* Log_ReadNext */
+	unsigned char (* prev)( unsigned char * dst );	/* Log_ReadPrev */
+	void (* cur)( unsigned char * dst );		/* Log_ReadCur */
+};
+
+
+#ifdef EE_SIM_DEVICE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef EE_SIM_SIZE
+#define EE_SIM_SIZE	4096
+#endif
+#ifndef EE_SIM_BUSY
+#define EE_SIM_BUSY	2
+#endif
+
+static unsigned char Ee_Mem[EE_SIM_SIZE];
+static struct Ee_SimStat Ee_Stat;
+static unsigned Ee_Busy;
+
+#ifdef EE_SIM_FAIL
+static unsigned long Ee_FailCnt;
+
+/* this write is lost */
+static int
+Ee_Lost( void )
+{
+	if ( ++Ee_FailCnt < (EE_SIM_FAIL) ) return 0;
+	Ee_FailCnt = 0;
+	++Ee_Stat.lost_writes;
+	return 1;
+}
+#else
+#define Ee_Lost()	0
+#endif
+
+static unsigned long
+Ee_Addr( void * a, unsigned n )
+{
+	unsigned long x = (unsigned long)(size_t) a;
+	if ( x + n > EE_SIM_SIZE )
+	{
+		fprintf( stderr, "EEPROM address %lu is out of memory\n", x );
+		abort();
+	}
+	return x;
+}
+
+static unsigned char
+ReadEE( void * a )
+{
+	++Ee_Stat.reads;
+	++Ee_Stat.bytes_read;
+	return Ee_Mem[Ee_Addr( a, 1 )];
+}
+
+static unsigned char
+isEEfree( void )
+{
+	++Ee_Stat.polls;
+	if ( Ee_Busy ) { --Ee_Busy; return 0; }
+	return 1;
+}
+
+static void
+WriteEE( void * a, unsigned char b )
+{
+	++Ee_Stat.writes;
+	++Ee_Stat.bytes_written;
+	if ( !Ee_Lost() ) Ee_Mem[Ee_Addr( a, 1 )] = b;
+	Ee_Busy = EE_SIM_BUSY;
+}
+
+#ifdef LOG_PAGE_SIZE
+static void
+WriteEEPage( void * a, const unsigned char * src, unsigned char n )
+{
+	unsigned long x = Ee_Addr( a, n );
+	if ( x / (LOG_PAGE_SIZE) != (x + n - 1) / (LOG_PAGE_SIZE) )
+	{
+		fprintf( stderr, "write across page at %lu (%u bytes)\n", x, n );
+		abort();
+	}
+	++Ee_Stat.page_writes;
+	Ee_Stat.bytes_written += n;
+	if ( !Ee_Lost() ) memcpy( Ee_Mem + x, src, n );
+	Ee_Busy = EE_SIM_BUSY;
+}
+#endif
+
+#ifdef LOG_BURST_READ
+static void
+ReadEEBlock( void * a, unsigned char * dst, unsigned char n )
+{
+	++Ee_Stat.block_reads;
+	Ee_Stat.bytes_read += n;
+	memcpy( dst, Ee_Mem + Ee_Addr( a, n ), n );
+}
+#endif
+
+#endif /* EE_SIM_DEVICE */
+
+#endif /* EE_SIM_H */
+
+
+/* End of file  ee-sim.h */